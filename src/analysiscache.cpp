@@ -0,0 +1,124 @@
+#include "analysiscache.hpp"
+#include <algorithm>
+#include <cstring>
+
+AnalysisCache analysisCache;
+
+// An unused run costs as much as this many plies of depth when replacing
+const int CACHE_AGE_WEIGHT = 4;
+
+struct AnalysisCacheHeader {
+	char magic[4];
+	uint32_t entrySize;
+	uint64_t bucketCount;
+	uint8_t generation;
+	uint8_t reserved[47];
+};
+
+static_assert(sizeof(AnalysisCacheEntry) == 16, "cache entries are packed into 64-byte buckets");
+static_assert(sizeof(AnalysisCacheHeader) == 64, "the header keeps buckets cache line aligned");
+
+bool AnalysisCache::open(const std::string& path, uint16_t engineVersion, size_t megabytes) {
+	std::lock_guard<std::mutex> lock(mutex);
+	closeFile();
+
+	uint64_t bucketCount = 1;
+	while (bucketCount * 2 * sizeof(Bucket) <= megabytes * 1024 * 1024) {
+		bucketCount *= 2;
+	}
+	if (!file.openWritable(path, sizeof(AnalysisCacheHeader) + bucketCount * sizeof(Bucket))) {
+		return false;
+	}
+
+	uint8_t* data = file.writableData();
+	AnalysisCacheHeader header;
+	std::memcpy(&header, data, sizeof(header));
+	if (std::memcmp(header.magic, "CRAC", 4) != 0 || header.entrySize != sizeof(AnalysisCacheEntry)
+		|| header.bucketCount != bucketCount) {
+		std::memset(data, 0, file.size());
+		std::memset(&header, 0, sizeof(header));
+		std::memcpy(header.magic, "CRAC", 4);
+		header.entrySize = sizeof(AnalysisCacheEntry);
+		header.bucketCount = bucketCount;
+	}
+	header.generation++;
+	std::memcpy(data, &header, sizeof(header));
+
+	buckets = reinterpret_cast<Bucket*>(data + sizeof(AnalysisCacheHeader));
+	mask = bucketCount - 1;
+	generation = header.generation;
+	version = engineVersion;
+	return true;
+}
+
+void AnalysisCache::close() {
+	std::lock_guard<std::mutex> lock(mutex);
+	closeFile();
+}
+
+bool AnalysisCache::isOpen() const {
+	std::lock_guard<std::mutex> lock(mutex);
+	return buckets != nullptr;
+}
+
+// With the mutex held
+void AnalysisCache::closeFile() {
+	file.flush();
+	file.close();
+	buckets = nullptr;
+}
+
+bool AnalysisCache::probe(uint64_t key, int& depth, int& score, Move& move) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!buckets) {
+		return false;
+	}
+	for (AnalysisCacheEntry& entry : buckets[key & mask].entries) {
+		if (entry.key == key && entry.version == version && entry.depth > 0) {
+			// Positions still in use don't age out
+			entry.generation = generation;
+			depth = entry.depth;
+			score = entry.score;
+			move = Move(entry.move);
+			return true;
+		}
+	}
+	return false;
+}
+
+void AnalysisCache::store(uint64_t key, int depth, int score, Move move) {
+	std::lock_guard<std::mutex> lock(mutex);
+	if (!buckets || depth <= 0) {
+		return;
+	}
+	Bucket& bucket = buckets[key & mask];
+
+	AnalysisCacheEntry* replace = nullptr;
+	int worst = 0;
+	for (AnalysisCacheEntry& entry : bucket.entries) {
+		if (entry.key == key && entry.version == version) {
+			// Keep a deeper result, and a best move this store doesn't have
+			if (depth < entry.depth) {
+				return;
+			}
+			if (move == Move::NO_MOVE) {
+				move = Move(entry.move);
+			}
+			replace = &entry;
+			break;
+		}
+		int age = uint8_t(generation - entry.generation);
+		int value = entry.version != version ? -1000 : entry.depth - CACHE_AGE_WEIGHT * age;
+		if (!replace || value < worst) {
+			replace = &entry;
+			worst = value;
+		}
+	}
+
+	replace->key = key;
+	replace->move = move.move();
+	replace->score = int16_t(score);
+	replace->depth = uint8_t(std::min(depth, 255));
+	replace->generation = generation;
+	replace->version = version;
+}
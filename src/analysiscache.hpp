@@ -0,0 +1,60 @@
+#pragma once
+
+#include "chess.hpp"
+#include "mappedfile.hpp"
+#include <cstdint>
+#include <mutex>
+#include <string>
+
+using namespace chess;
+
+// Search results kept on disk between runs, so positions that come up in
+// game after game (openings above all) are only searched once.
+//
+// The file is a fixed-size open-addressing hash table of 4-entry buckets
+// indexed by Board::hash(), memory-mapped read-write. Entries from another
+// engine version never hit and are the first to be replaced. Otherwise the
+// shallowest entry goes, counting each run since it was last used as a few
+// plies of depth.
+
+const size_t ANALYSIS_CACHE_MB = 16;
+
+struct AnalysisCacheEntry {
+	uint64_t key;
+	uint16_t move;
+	int16_t score;
+	uint8_t depth;
+	uint8_t generation;
+	uint16_t version;
+};
+
+class AnalysisCache {
+public:
+	// Maps the cache file, creating or resetting it when it's missing or
+	// doesn't match this size. Every open starts a new generation.
+	bool open(const std::string& path, uint16_t version, size_t megabytes = ANALYSIS_CACHE_MB);
+	void close();
+	bool isOpen() const;
+
+	// Score from the side to move's point of view. The move is NO_MOVE for
+	// positions that were only scored as the reply to a root move.
+	bool probe(uint64_t key, int& depth, int& score, Move& move);
+	void store(uint64_t key, int depth, int score, Move move);
+
+private:
+	void closeFile();
+
+	static const int BUCKET_SIZE = 4;
+	struct Bucket {
+		AnalysisCacheEntry entries[BUCKET_SIZE];
+	};
+
+	MappedFile file;
+	Bucket* buckets = nullptr;
+	uint64_t mask = 0;
+	uint8_t generation = 0;
+	uint16_t version = 0;
+	mutable std::mutex mutex;
+};
+
+extern AnalysisCache analysisCache;
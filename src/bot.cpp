@@ -1,11 +1,16 @@
 #include "bot.hpp"
-#include <thread>
+#include "movepicker.hpp"
+#include "see.hpp"
+#include "threadpool.hpp"
 #include <vector>
 #include <string>
 #include <iostream>
 #include <algorithm>
+#include <array>
+#include <cmath>
+#include <cstdlib>
 
-
+TranspositionTable transpositionTable(TT_SIZE_MB);
 
 int getPieceValue(PieceType type) {
 	if (type == PieceType::PAWN) {
@@ -29,21 +34,70 @@ int getPieceValue(PieceType type) {
 	return 0;
 }
 
-int countMaterial(const Board& board, Color side) {
-	Bitboard us = board.us(side);
-	int pawns = (board.pieces(PieceType::PAWN) & us).count() * PAWN_VALUE;
-	int knights = (board.pieces(PieceType::KNIGHT) & us).count() * KNIGHT_VALUE;
-	int bishops = (board.pieces(PieceType::BISHOP) & us).count() * BISHOP_VALUE;
-	int rooks = (board.pieces(PieceType::ROOK) & us).count() * ROOK_VALUE;
-	int queens = (board.pieces(PieceType::QUEEN) & us).count() * QUEEN_VALUE;
-	return pawns + knights + bishops + rooks + queens;
+// Pawn shelter only counts while the king is still on its first two ranks
+static int kingShelter(const SearchBoard& board, const PawnEntry& pawns, Color side) {
+	Square king = board.kingSq(side);
+	int rank = king.rank();
+	int relativeRank = side == Color::WHITE ? rank : 7 - rank;
+	if (relativeRank > 1) {
+		return 0;
+	}
+	return pawns.shelter[int(side)][king.file()];
+}
+
+static bool bishopsOnBothColours(const SearchBoard& board, Color side) {
+	Bitboard bishops = board.pieces(PieceType::BISHOP, side);
+	Square first = bishops.pop();
+	while (bishops) {
+		if (!Square::same_color(first, bishops.pop())) {
+			return true;
+		}
+	}
+	return false;
+}
+
+static int scaleFactor(const SearchBoard& board, const MaterialEntry& material, int evaluation) {
+	int scale = material.scale[evaluation > 0 ? 0 : 1];
+	// Like two knights, bishops all on one colour can't force mate, and
+	// without pawns on the board there's nothing else to win with
+	Color side = evaluation > 0 ? Color::WHITE : Color::BLACK;
+	if (material.bishopsOnly[int(side)] && !board.pieces(PieceType::PAWN) && !bishopsOnBothColours(board, side)) {
+		return 0;
+	}
+	if (material.loneBishops && scale > SCALE_OPPOSITE_BISHOPS) {
+		Square white = board.pieces(PieceType::BISHOP, Color::WHITE).lsb();
+		Square black = board.pieces(PieceType::BISHOP, Color::BLACK).lsb();
+		if (!Square::same_color(white, black)) {
+			scale = SCALE_OPPOSITE_BISHOPS;
+		}
+	}
+	return scale;
 }
 
-int evaluate(const Board& board) {
-	int whiteEval = countMaterial(board, Color::WHITE);
-	int blackEval = countMaterial(board, Color::BLACK);
+// Static evaluation from the side to move's point of view. Bishops all on
+// one colour can't mate, so they get the normal evaluation and its scaling
+// instead of the endgame's.
+int evaluate(const SearchBoard& board, ThreadData& td) {
+	const MaterialEntry& material = td.materialTable.probe(board);
+	if (material.endgame && (!material.bishopsOnly[int(material.strongSide)] ||
+		bishopsOnBothColours(board, material.strongSide))) {
+		int score = material.endgame(board, material.strongSide);
+		return board.sideToMove() == material.strongSide ? score : -score;
+	}
 
-	int evaluation = whiteEval - blackEval;
+	int evaluation;
+	if (board.usesNnue()) {
+		evaluation = board.sideToMove() == Color::WHITE ? board.nnueScore() : -board.nnueScore();
+	}
+	else {
+		const PawnEntry& pawns = td.pawnTable.probe(board);
+		int shelter = kingShelter(board, pawns, Color::WHITE) - kingShelter(board, pawns, Color::BLACK);
+		evaluation = board.psqtScore() + material.imbalance
+			+ taper(pawns.midgame + shelter, pawns.endgame, board.phase());
+	}
+	evaluation = evaluation * scaleFactor(board, material, evaluation) / SCALE_NORMAL;
+	// Keep the evaluation clear of the mate range
+	evaluation = std::clamp(evaluation, -MATE_BOUND + 1, MATE_BOUND - 1);
 
 	if (board.sideToMove() == Color::WHITE) {
 		return evaluation;
@@ -57,145 +111,514 @@ bool compareMoves(Move a, Move b) {
 	return a.score() > b.score();
 }
 
-PieceType getPieceType(const Board& board, Square square) {
-	Bitboard squareBit;
-	squareBit = squareBit |= (1ULL << square.index());
-	uint64_t pawn = (squareBit & board.pieces(PieceType::PAWN)).getBits();
-	if (pawn) return PieceType::PAWN;
-
-	uint64_t bishop = (squareBit & board.pieces(PieceType::BISHOP)).getBits();
-	if (bishop) return PieceType::BISHOP;
+// Nodes are flushed to the shared counter in batches so threads don't contend
+// on it at every node.
+const uint64_t NODE_CHECK_INTERVAL = 1024;
 
-	uint64_t knight = (squareBit & board.pieces(PieceType::KNIGHT)).getBits();
-	if (knight) return PieceType::KNIGHT;
+void checkLimits(ThreadData& td) {
+	SearchContext& context = *td.context;
+	uint64_t total = context.nodes.fetch_add(td.nodes, std::memory_order_relaxed) + td.nodes;
+	td.nodes = 0;
 
-	uint64_t rook = (squareBit & board.pieces(PieceType::ROOK)).getBits();
-	if (rook) return PieceType::ROOK;
-
-	uint64_t queen = (squareBit & board.pieces(PieceType::QUEEN)).getBits();
-	if (queen) return PieceType::QUEEN;
-
-	uint64_t king = (squareBit & board.pieces(PieceType::KING)).getBits();
-	if (king) return PieceType::KING;
-
-	return PieceType::NONE;
-}
-
-int calculateMoveScore(const Board& board, Move move) {
-	int moveScoreGuess = 0;
-	PieceType fromType = getPieceType(board, move.from());
-	PieceType toType = getPieceType(board, move.to());
-
-	if (toType != PieceType::NONE) {
-		moveScoreGuess = 10 * getPieceValue(toType) - getPieceValue(fromType);
+	if (!context.hasResult.load(std::memory_order_relaxed)) {
+		return;
 	}
-
-	if (move == Move::PROMOTION) {
-		moveScoreGuess += getPieceValue(move.promotionType());
+	if (context.limits.nodes && total >= context.limits.nodes) {
+		context.stop = true;
 	}
-
-	if (board.isAttacked(move.to(), ~board.sideToMove())) {
-		moveScoreGuess -= getPieceValue(fromType);
+	if (context.limits.milliseconds) {
+		auto elapsed = std::chrono::steady_clock::now() - context.startTime;
+		if (std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count() >= context.limits.milliseconds) {
+			context.stop = true;
+		}
 	}
+}
 
-	return moveScoreGuess;
+bool countNode(ThreadData& td) {
+	if (++td.nodes >= NODE_CHECK_INTERVAL) {
+		checkLimits(td);
+	}
+	return td.context->stop.load(std::memory_order_relaxed);
 }
 
-int captureSearch(Board board, int alpha, int beta, int ply) {
-    int standPat = evaluate(board);
+int captureSearch(SearchBoard& board, ThreadData& td, int alpha, int beta, int ply) {
+    if (countNode(td)) {
+        return 0;
+    }
+    if (ply >= MAX_PLY) {
+        return evaluate(board, td);
+    }
+
+    TTEntry entry;
+    Move hashMove = Move::NO_MOVE;
+    if (transpositionTable.probe(board.hash(), entry)) {
+        int ttScore = scoreFromTT(entry.score, ply);
+        if (entry.bound == BOUND_EXACT ||
+            (entry.bound == BOUND_LOWER && ttScore >= beta) ||
+            (entry.bound == BOUND_UPPER && ttScore <= alpha)) {
+            return ttScore;
+        }
+        hashMove = entry.move;
+    }
+
+    int standPat = evaluate(board, td);
     
     if (standPat >= beta) {
-        return beta;
+        return standPat;
     }
+    int originalAlpha = alpha;
     alpha = std::max(alpha, standPat);
 
-    Movelist captures;
-    movegen::legalmoves<movegen::MoveGenType::CAPTURE>(captures, board);
+    CapturePicker picker(board, td.ordering, hashMove);
 
-    for (auto& move : captures) {
-        move.setScore(calculateMoveScore(board, move));
-    }
-    std::sort(captures.begin(), captures.end(), compareMoves);
+    int bestScore = standPat;
+    Move bestMove = Move::NO_MOVE;
+    Move capture;
+    while ((capture = picker.next()) != Move::NO_MOVE) {
+        // A capture that loses material can't raise the stand pat score
+        if (staticExchange(board, capture) < 0) {
+            continue;
+        }
 
-    for (const auto& capture : captures) {
         board.makeMove(capture);
-        int eval = -captureSearch(board, -beta, -alpha, ply + 1);
+        int eval = -captureSearch(board, td, -beta, -alpha, ply + 1);
         board.unmakeMove(capture);
+        if (td.context->stop) {
+            return 0;
+        }
 
-        if (eval >= beta) {
-            return beta;
+        if (eval > bestScore) {
+            bestScore = eval;
+            if (eval > alpha) {
+                alpha = eval;
+                bestMove = capture;
+            }
+            if (eval >= beta) {
+                break;
+            }
         }
-        alpha = std::max(alpha, eval);
     }
 
-    return alpha;
+    Bound bound = bestScore >= beta ? BOUND_LOWER : bestScore > originalAlpha ? BOUND_EXACT : BOUND_UPPER;
+    transpositionTable.store(board.hash(), 0, bound, scoreToTT(bestScore, ply), bestMove);
+    return bestScore;
 }
 
-int search(Board board, int depth, int ply, int alpha, int beta) {
-	if (depth == 0) {
-		return captureSearch(board, alpha, beta, ply);
+// Late move reductions grow with both the remaining depth and how late the
+// move comes in the ordering.
+static const auto lmrTable = [] {
+	std::array<std::array<int, 64>, MAX_PLY> table{};
+	for (int depth = 1; depth < MAX_PLY; depth++) {
+		for (int moveIndex = 1; moveIndex < 64; moveIndex++) {
+			table[depth][moveIndex] = int(0.75 + std::log(depth) * std::log(moveIndex) / 2.25);
+		}
+	}
+	return table;
+}();
+
+// Tablebase result as a search score. Shorter routes to mate or conversion
+// score higher, so the search keeps making progress inside a table.
+static int tablebaseScore(const TablebaseResult& result, int ply) {
+	if (result.wdl == TB_WIN) {
+		return TB_WIN_SCORE - ply - result.distance;
+	}
+	if (result.wdl == TB_LOSS) {
+		return -TB_WIN_SCORE + ply + result.distance;
 	}
+	return 0;
+}
 
-	Movelist moves;
-	movegen::legalmoves(moves, board);
-	if (moves.size() == 0) {
-		if (board.inCheck()) {
-			return -KING_VALUE + ply;
-		}
+// Fail-soft principal variation search. The first move gets the full window;
+// the rest are probed with a null window and only re-searched if they fail
+// high inside a PV node.
+int search(SearchBoard& board, ThreadData& td, int depth, int ply, int alpha, int beta, bool allowNull) {
+	if (depth <= 0) {
+		return captureSearch(board, td, alpha, beta, ply);
+	}
+	if (countNode(td)) {
 		return 0;
 	}
-	for (auto& move : moves) {
-		move.setScore(calculateMoveScore(board, move));
+	if (ply >= MAX_PLY) {
+		return evaluate(board, td);
+	}
+
+	TablebaseResult tablebaseResult;
+	if (board.occ().count() <= tablebases.maxPieces() && tablebases.probe(board, tablebaseResult)) {
+		return tablebaseScore(tablebaseResult, ply);
+	}
+
+	const SearchOptions& options = td.context->options;
+	bool pvNode = beta - alpha > 1;
+	bool inCheck = board.inCheck();
+
+	TTEntry entry;
+	Move hashMove = Move::NO_MOVE;
+	if (transpositionTable.probe(board.hash(), entry)) {
+		int ttScore = scoreFromTT(entry.score, ply);
+		if (!pvNode && entry.depth >= depth && (entry.bound == BOUND_EXACT ||
+			(entry.bound == BOUND_LOWER && ttScore >= beta) ||
+			(entry.bound == BOUND_UPPER && ttScore <= alpha))) {
+			return ttScore;
+		}
+		hashMove = entry.move;
 	}
-	std::sort(moves.begin(), moves.end(), compareMoves);
 
-	for (const auto& move : moves) {
+	int staticEval = inCheck ? -MATE_SCORE : evaluate(board, td);
+	bool canPrune = !pvNode && !inCheck && std::abs(beta) < MATE_BOUND;
+
+	// Reverse futility: far enough above beta that a quiet move is unlikely to
+	// lose it all back
+	if (options.futility && canPrune && depth <= REVERSE_FUTILITY_MAX_DEPTH &&
+		staticEval - REVERSE_FUTILITY_MARGIN * depth >= beta) {
+		return staticEval;
+	}
+
+	// Null move: if passing still fails high, a real move almost surely would.
+	// Skipped without pieces because of zugzwang.
+	if (options.nullMove && canPrune && allowNull && depth >= NULL_MOVE_MIN_DEPTH && staticEval >= beta &&
+		board.hasNonPawnMaterial(board.sideToMove())) {
+		int reduction = 2 + depth / 4;
+		td.moveStack[ply] = Move(Move::NULL_MOVE);
+		board.makeNullMove();
+		int eval = -search(board, td, depth - 1 - reduction, ply + 1, -beta, -beta + 1, false);
+		board.unmakeNullMove();
+		if (td.context->stop) {
+			return 0;
+		}
+		if (eval >= beta) {
+			return eval >= MATE_BOUND ? beta : eval;
+		}
+	}
+
+	Move previousMove = ply > 0 ? td.moveStack[ply - 1] : Move(Move::NO_MOVE);
+	MovePicker picker(board, td.ordering, hashMove, ply, previousMove);
+
+	bool futile = options.futility && canPrune && depth <= FUTILITY_MAX_DEPTH &&
+		staticEval + FUTILITY_MARGIN * depth <= alpha;
+
+	int originalAlpha = alpha;
+	int bestScore = -MATE_SCORE;
+	Move bestMove = Move::NO_MOVE;
+	Move quietsTried[64];
+	int quietCount = 0;
+	int moveCount = 0;
+	Move move;
+	while ((move = picker.next()) != Move::NO_MOVE) {
+		int i = moveCount++;
+		bool quiet = !board.isCapture(move) && move.typeOf() != Move::PROMOTION;
+
+		td.moveStack[ply] = move;
 		board.makeMove(move);
-		int eval = -search(board, depth - 1, ply + 1, -beta, -alpha);
+		bool givesCheck = board.inCheck();
+
+		// Futility: quiet moves can't raise a hopeless static eval to alpha
+		if (futile && i > 0 && quiet && !givesCheck) {
+			board.unmakeMove(move);
+			bestScore = std::max(bestScore, staticEval);
+			continue;
+		}
+
+		int eval;
+		if (i == 0) {
+			eval = -search(board, td, depth - 1, ply + 1, -beta, -alpha);
+		}
+		else {
+			int reduction = 0;
+			if (options.lateMoveReductions && depth >= LMR_MIN_DEPTH && i >= LMR_MIN_MOVES && quiet && !inCheck && !givesCheck) {
+				reduction = lmrTable[depth][std::min(i, 63)] + !pvNode;
+				reduction = std::clamp(reduction, 0, depth - 2);
+			}
+
+			eval = -search(board, td, depth - 1 - reduction, ply + 1, -alpha - 1, -alpha);
+			if (reduction > 0 && eval > alpha) {
+				eval = -search(board, td, depth - 1, ply + 1, -alpha - 1, -alpha);
+			}
+			if (eval > alpha && eval < beta) {
+				eval = -search(board, td, depth - 1, ply + 1, -beta, -alpha);
+			}
+		}
 		board.unmakeMove(move);
-		if (eval >= beta) {
-			return beta;
+		if (td.context->stop) {
+			return 0;
 		}
-		alpha = std::max(alpha, eval);
+
+		if (eval > bestScore) {
+			bestScore = eval;
+			if (eval > alpha) {
+				alpha = eval;
+				bestMove = move;
+			}
+			if (eval >= beta) {
+				if (quiet) {
+					td.ordering.updateQuietCutoff(board, move, depth, ply, previousMove, quietsTried, quietCount);
+				}
+				break;
+			}
+		}
+		if (quiet && quietCount < 64) {
+			quietsTried[quietCount++] = move;
+		}
+	}
+
+	if (moveCount == 0) {
+		return inCheck ? -MATE_SCORE + ply : 0;
 	}
 
-	return alpha;
+	Bound bound = bestScore >= beta ? BOUND_LOWER : bestScore > originalAlpha ? BOUND_EXACT : BOUND_UPPER;
+	transpositionTable.store(board.hash(), depth, bound, scoreToTT(bestScore, ply), bestMove);
+	return bestScore;
 }
 
-void worker(const Board& board, int searchDepth, int* result) {
-	int evaluation = -search(board, searchDepth, 0, -KING_VALUE, KING_VALUE);
-	*result = evaluation;
+int rootSearch(SearchBoard& board, ThreadData& td, Movelist& moves, int depth, int alpha, int beta) {
+	int originalAlpha = alpha;
+	int bestScore = -MATE_SCORE;
+	int bestIndex = -1;
+
+	for (int i = 0; i < moves.size(); i++) {
+		td.moveStack[0] = moves[i];
+		board.makeMove(moves[i]);
+		int eval;
+		if (moves[i] == td.context->scoredMove) {
+			// The caller wants this score exact, whatever the window
+			eval = -search(board, td, depth - 1, 1, -MATE_SCORE, MATE_SCORE);
+			td.scoredMoveScore = eval;
+		}
+		else if (i == 0) {
+			eval = -search(board, td, depth - 1, 1, -beta, -alpha);
+		}
+		else {
+			eval = -search(board, td, depth - 1, 1, -alpha - 1, -alpha);
+			if (eval > alpha && eval < beta) {
+				eval = -search(board, td, depth - 1, 1, -beta, -alpha);
+			}
+		}
+		board.unmakeMove(moves[i]);
+		if (td.context->stop) {
+			return 0;
+		}
+
+		if (eval > bestScore) {
+			bestScore = eval;
+			if (eval > alpha) {
+				alpha = eval;
+				bestIndex = i;
+			}
+			if (eval >= beta) {
+				break;
+			}
+		}
+	}
+
+	// Search the best move of this iteration first in the next one. After a
+	// fail low no move is known to be better than the current first one.
+	if (bestIndex > 0) {
+		std::rotate(moves.begin(), moves.begin() + bestIndex, moves.begin() + bestIndex + 1);
+	}
+	Bound bound = bestScore >= beta ? BOUND_LOWER : bestScore > originalAlpha ? BOUND_EXACT : BOUND_UPPER;
+	transpositionTable.store(board.hash(), depth, bound, scoreToTT(bestScore, 0), bestIndex >= 0 ? moves[0] : Move(Move::NO_MOVE));
+	return bestScore;
 }
 
-Move findBestMove(Board board, int searchDepth) {
+// Searches the root with a narrow window around the previous iteration's
+// score, widening the failing side until the score lands inside it.
+int aspirationSearch(SearchBoard& board, ThreadData& td, Movelist& moves, int depth, int previousScore) {
+	if (depth < ASPIRATION_MIN_DEPTH || std::abs(previousScore) >= MATE_BOUND) {
+		return rootSearch(board, td, moves, depth, -MATE_SCORE, MATE_SCORE);
+	}
+
+	int delta = ASPIRATION_WINDOW;
+	int alpha = std::max(previousScore - delta, -MATE_SCORE);
+	int beta = std::min(previousScore + delta, MATE_SCORE);
+	while (true) {
+		int score = rootSearch(board, td, moves, depth, alpha, beta);
+		if (td.context->stop) {
+			return 0;
+		}
+		if (score <= alpha && alpha > -MATE_SCORE) {
+			alpha = std::max(score - delta, -MATE_SCORE);
+		}
+		else if (score >= beta && beta < MATE_SCORE) {
+			beta = std::min(score + delta, MATE_SCORE);
+		}
+		else {
+			return score;
+		}
+		delta *= 2;
+	}
+}
+
+// Lazy SMP: every thread runs its own iterative deepening over the same root
+// and they cooperate only through the transposition table. Odd helper threads
+// start one ply deeper so the threads don't all search the same tree in step.
+SearchResult iterativeDeepening(const Board& rootBoard, ThreadData& td) {
+	SearchContext& context = *td.context;
+	SearchBoard board(rootBoard);
+
+	SearchResult result;
 	Movelist moves;
 	movegen::legalmoves(moves, board);
-	for (auto& move : moves) {
-		move.setScore(calculateMoveScore(board, move));
+	if (moves.size() == 0) {
+		result.score = board.inCheck() ? -MATE_SCORE : 0;
+		return result;
 	}
+	// An earlier search of the position, such as a shallower pass over the
+	// same game or the search of the position before, leaves its best move in
+	// the table
+	TTEntry entry;
+	Move hashMove = transpositionTable.probe(board.hash(), entry) ? entry.move : context.seed.move;
+	td.ordering.scoreMoves(board, moves, hashMove, 0, Move::NO_MOVE);
 	std::sort(moves.begin(), moves.end(), compareMoves);
 
-	std::vector<std::thread> threads;
-	std::vector<int> evaluations(moves.size());
+	// The scored move gets a full window wherever it is, so searching it
+	// first lets its score bound the rest
+	Move* scored = std::find(moves.begin(), moves.end(), context.scoredMove);
+	bool hasScoredMove = scored != moves.end();
+	if (hasScoredMove) {
+		std::rotate(moves.begin(), scored, scored + 1);
+	}
+	// The thread's last search may have scored a move of another position
+	td.scoredMoveScore = -MATE_SCORE;
 
-	for (int i = 0; i < moves.size(); i++) {
-		board.makeMove(moves[i]);
-		threads.push_back(std::thread(worker, board, searchDepth, &evaluations[i]));
-		board.unmakeMove(moves[i]);
+	int maxDepth = std::min(context.limits.maxDepth, MAX_PLY - 1);
+	for (int depth = 1 + td.id % 2; depth <= maxDepth; depth++) {
+		int score = aspirationSearch(board, td, moves, depth, result.score);
+
+		// An interrupted iteration only has partial scores, keep the previous one
+		if (context.stop) {
+			break;
+		}
+
+		if (result.depth > 0) {
+			result.swing = std::abs(score - result.score);
+			if (hasScoredMove) {
+				result.swing = std::max(result.swing, std::abs(td.scoredMoveScore - result.scoredMoveScore));
+			}
+		}
+		result.bestMove = moves[0];
+		result.score = score;
+		result.depth = depth;
+		if (hasScoredMove) {
+			result.scoredMoveScore = td.scoredMoveScore;
+		}
+
+		{
+			std::lock_guard<std::mutex> lock(context.resultMutex);
+			if (depth > context.result.depth || (depth == context.result.depth && td.id == 0)) {
+				context.result = result;
+			}
+		}
+		context.hasResult = true;
+
+		// Nothing to gain from searching deeper once a forced mate is found.
+		// A mate longer than the depth came out of the transposition table
+		// and may not be the shortest, so keep going until it's in reach.
+		if (std::abs(score) >= MATE_BOUND && MATE_SCORE - std::abs(score) <= depth) {
+			break;
+		}
+	}
+
+	if (result.bestMove != Move::NO_MOVE) {
+		board.makeMove(result.bestMove);
+		if (transpositionTable.probe(board.hash(), entry)) {
+			result.expectedReply = entry.move;
+		}
+		board.unmakeMove(result.bestMove);
 	}
 
-	for (int i = 0; i < threads.size(); i++) {
-		threads[i].join();
+	checkLimits(td);
+	return result;
+}
+
+// Picks the root move straight from the tablebases: the fastest win, any
+// draw, or the slowest loss. Moves are ranked by plies to mate or
+// conversion. Fails if the root or any move after it isn't in a table.
+static bool probeRoot(const Board& board, Move scoredMove, SearchResult& result) {
+	TablebaseResult root;
+	if (!tablebases.probe(board, root)) {
+		return false;
+	}
+	Movelist moves;
+	movegen::legalmoves(moves, board);
+	if (moves.size() == 0) {
+		return false;
 	}
 
-	int bestMoveEval = -KING_VALUE;
-	int bestMoveIndex = 0;
-	for (int i = 0; i < evaluations.size(); i++) {
-		if (evaluations[i] > bestMoveEval) {
-			bestMoveEval = evaluations[i];
-			bestMoveIndex = i;
+	Board child = board;
+	int bestRank = 0;
+	Move bestMove = Move::NO_MOVE;
+	for (const Move& move : moves) {
+		bool conversion = child.isCapture(move) || move.typeOf() == Move::PROMOTION;
+		child.makeMove(move);
+		TablebaseResult reply;
+		bool found = tablebases.probe(child, reply);
+		child.unmakeMove(move);
+		if (!found) {
+			return false;
 		}
+		if (move == scoredMove) {
+			result.scoredMoveScore = -tablebaseScore(reply, 1);
+		}
+
+		// The reply is from the opponent's side, so a win for us is a loss there
+		TablebaseWdl outcome = reply.wdl == TB_WIN ? TB_LOSS : reply.wdl == TB_LOSS ? TB_WIN : TB_DRAW;
+		if (outcome != root.wdl) {
+			continue;
+		}
+		int rank = reply.distance == 0 ? 0 : conversion ? 1 : reply.distance + 1;
+		bool better = bestMove == Move::NO_MOVE || (root.wdl == TB_WIN && rank < bestRank) ||
+			(root.wdl == TB_LOSS && rank > bestRank);
+		if (better) {
+			bestRank = rank;
+			bestMove = move;
+		}
+	}
+	if (bestMove == Move::NO_MOVE) {
+		return false;
 	}
 
-	return moves[bestMoveIndex];
-}
\ No newline at end of file
+	result.bestMove = bestMove;
+	result.score = tablebaseScore(root, 0);
+	result.depth = 1;
+	result.nodes = 0;
+	return true;
+}
+
+SearchResult findBestMove(const Board& board, const SearchLimits& limits, const SearchOptions& options) {
+	return findBestMove(board, limits, Move::NO_MOVE, options);
+}
+
+SearchResult findBestMove(const Board& board, const SearchLimits& limits, Move scoredMove, const SearchOptions& options) {
+	SearchResult result;
+	if (probeRoot(board, scoredMove, result)) {
+		return result;
+	}
+	return searchPool.search(board, limits, options, scoredMove);
+}
+
+SearchResult searchPosition(const Board& board, ThreadData& td, const SearchLimits& limits, Move scoredMove,
+	const SearchSeed& seed, const SearchOptions& options) {
+	SearchResult result;
+	if (probeRoot(board, scoredMove, result)) {
+		return result;
+	}
+
+	SearchContext context;
+	context.limits = limits;
+	context.options = options;
+	context.scoredMove = scoredMove;
+	context.seed = seed;
+	context.startTime = std::chrono::steady_clock::now();
+	td.context = &context;
+	td.nodes = 0;
+	if (seed.followsLastSearch) {
+		td.ordering.advance();
+	}
+	else {
+		td.ordering.newSearch();
+	}
+
+	result = iterativeDeepening(board, td);
+	result.nodes = context.nodes;
+	td.context = nullptr;
+	return result;
+}
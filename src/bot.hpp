@@ -1,17 +1,141 @@
 #pragma once
 
 #include "chess.hpp"
+#include "material.hpp"
+#include "moveorder.hpp"
+#include "pawns.hpp"
+#include "searchboard.hpp"
+#include "tablebase.hpp"
+#include "tt.hpp"
+#include <array>
+#include <atomic>
+#include <chrono>
 #include <climits>
+#include <cstdint>
+#include <mutex>
 
 using namespace chess;
 
-const int PAWN_VALUE = 1;
-const int KNIGHT_VALUE = 3;
-const int BISHOP_VALUE = 3;
-const int ROOK_VALUE = 5;
-const int QUEEN_VALUE = 9;
-const int KING_VALUE = 1000;
+// Exchange values in centipawns, used by SEE and the pruning margins. The
+// evaluation itself uses the tapered tables in psqt.hpp.
+const int PAWN_VALUE = 100;
+const int KNIGHT_VALUE = 320;
+const int BISHOP_VALUE = 330;
+const int ROOK_VALUE = 500;
+const int QUEEN_VALUE = 900;
+const int KING_VALUE = 20000;
 
-int search(Board board, int depth, int ply, int alpha, int beta);
+// Mate scores are MATE_SCORE minus the distance in plies, and MATE_SCORE also
+// serves as infinity for the search window. It has to fit the 16-bit score
+// fields of Move and the transposition table.
+const int MATE_SCORE = 32000;
+const int MATE_BOUND = MATE_SCORE - MAX_PLY;
+// Tablebase wins are TB_WIN_SCORE minus the ply and the distance to
+// conversion, below every mate and above every static evaluation
+const int TB_WIN_SCORE = MATE_BOUND - MAX_PLY;
+// Lowest tablebase win: the deepest ply and the longest distance a table
+// stores, 255 plies
+const int TB_BOUND = TB_WIN_SCORE - MAX_PLY - 255;
+const size_t TT_SIZE_MB = 64;
+
+const int ASPIRATION_MIN_DEPTH = 4;
+const int ASPIRATION_WINDOW = PAWN_VALUE / 4;
+
+const int NULL_MOVE_MIN_DEPTH = 3;
+const int LMR_MIN_DEPTH = 3;
+const int LMR_MIN_MOVES = 3;
+const int FUTILITY_MAX_DEPTH = 3;
+const int FUTILITY_MARGIN = 3 * PAWN_VALUE / 2;
+const int REVERSE_FUTILITY_MAX_DEPTH = 6;
+const int REVERSE_FUTILITY_MARGIN = 3 * PAWN_VALUE / 4;
+
+// Bumped whenever search or evaluation changes, so cached analysis from
+// older versions is searched again
+const uint16_t ENGINE_VERSION = 1;
+
+extern TranspositionTable transpositionTable;
+
+// A limit of 0 means unlimited. The first iteration always completes, so a
+// search with a tiny budget still returns a legal move.
+struct SearchLimits {
+	int maxDepth = MAX_PLY;
+	uint64_t nodes = 0;
+	int64_t milliseconds = 0;
+};
+
+struct SearchResult {
+	Move bestMove = Move::NO_MOVE;
+	int score = 0;
+	int depth = 0;
+	uint64_t nodes = 0;
+	// Exact score of the requested root move, if there was one
+	int scoredMoveScore = 0;
+	// How far the score or the scored move's score moved in the last iteration
+	int swing = 0;
+	// Reply to the best move the search expects, from the transposition table
+	Move expectedReply = Move::NO_MOVE;
+};
+
+// What the search of the previous position in a game passes on to the search
+// of the next one
+struct SearchSeed {
+	// Reply the previous search expected, if that's the move that was played.
+	// Leads the root when the table no longer has the position.
+	Move move = Move::NO_MOVE;
+	// The thread's last search had the previous position at its root, so its
+	// killers still apply a ply further up
+	bool followsLastSearch = false;
+};
+
+// Selective search switches, all on by default
+struct SearchOptions {
+	bool nullMove = true;
+	bool lateMoveReductions = true;
+	bool futility = true;
+};
+
+// State shared by every thread taking part in one search
+struct SearchContext {
+	SearchLimits limits;
+	SearchOptions options;
+	Move scoredMove = Move::NO_MOVE;
+	SearchSeed seed;
+	std::chrono::steady_clock::time_point startTime;
+	std::atomic<bool> stop{false};
+	std::atomic<bool> hasResult{false};
+	std::atomic<uint64_t> nodes{0};
+
+	// Deepest completed iteration of any thread
+	std::mutex resultMutex;
+	SearchResult result;
+};
+
+// Per-thread search state, kept alive between searches by the thread pool
+struct ThreadData {
+	int id = 0;
+	SearchContext* context = nullptr;
+	uint64_t nodes = 0;
+	// Score of the context's scored move in the latest root search,
+	// -MATE_SCORE until it has one
+	int scoredMoveScore = 0;
+
+	MoveOrdering ordering;
+	PawnTable pawnTable;
+	MaterialTable materialTable;
+	// Move made at each ply of the current line
+	std::array<Move, MAX_PLY + 1> moveStack;
+};
+
+int search(SearchBoard& board, ThreadData& td, int depth, int ply, int alpha, int beta, bool allowNull = true);
 int getPieceValue(PieceType type);
-Move findBestMove(Board board, int searchDepth);
\ No newline at end of file
+int evaluate(const SearchBoard& board, ThreadData& td);
+void checkLimits(ThreadData& td);
+SearchResult iterativeDeepening(const Board& board, ThreadData& td);
+SearchResult findBestMove(const Board& board, const SearchLimits& limits, const SearchOptions& options = SearchOptions());
+// Same search, also giving the exact score of `scoredMove`, a legal move at
+// the root. Costs about as much as finding the best move alone.
+SearchResult findBestMove(const Board& board, const SearchLimits& limits, Move scoredMove, const SearchOptions& options = SearchOptions());
+// Single-threaded search on the caller's thread, for running several
+// searches side by side. The caller ages the transposition table.
+SearchResult searchPosition(const Board& board, ThreadData& td, const SearchLimits& limits, Move scoredMove,
+	const SearchSeed& seed = SearchSeed(), const SearchOptions& options = SearchOptions());
\ No newline at end of file
@@ -0,0 +1,198 @@
+#include "endgame.hpp"
+#include "bot.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+
+static int pushToEdge(Square sq) {
+	int file = sq.file();
+	int rank = sq.rank();
+	int fileDistance = std::max(3 - file, file - 4);
+	int rankDistance = std::max(3 - rank, rank - 4);
+	return 20 * (fileDistance + rankDistance);
+}
+
+static int pushClose(Square a, Square b) {
+	return 140 - 20 * Square::distance(a, b);
+}
+
+static int nonPawnMaterial(const SearchBoard& board, Color side) {
+	int material = 0;
+	for (PieceType type : {PieceType::KNIGHT, PieceType::BISHOP, PieceType::ROOK, PieceType::QUEEN}) {
+		material += board.count(Piece(type, side)) * getPieceValue(type);
+	}
+	return material;
+}
+
+// A bare king with no moves is stalemate. The search only notices that at
+// interior nodes, so the evaluators have to check for it themselves.
+static bool weakSideStalemated(const SearchBoard& board, Color strong) {
+	if (board.sideToMove() == strong || board.inCheck()) {
+		return false;
+	}
+	Movelist moves;
+	movegen::legalmoves(moves, board);
+	return moves.empty();
+}
+
+int evaluateKXK(const SearchBoard& board, Color strong) {
+	if (weakSideStalemated(board, strong)) {
+		return 0;
+	}
+
+	Square strongKing = board.kingSq(strong);
+	Square weakKing = board.kingSq(~strong);
+	int material = nonPawnMaterial(board, strong) + board.pieces(PieceType::PAWN, strong).count() * PAWN_VALUE;
+	return KNOWN_WIN + material + pushToEdge(weakKing) + pushClose(strongKing, weakKing);
+}
+
+int evaluateKBNK(const SearchBoard& board, Color strong) {
+	if (weakSideStalemated(board, strong)) {
+		return 0;
+	}
+
+	Square strongKing = board.kingSq(strong);
+	Square weakKing = board.kingSq(~strong);
+	Square bishop = board.pieces(PieceType::BISHOP, strong).lsb();
+
+	// Mate only works in a corner of the bishop's colour. Mirror the board
+	// so those are a1 and h8, where the distance to the long diagonal is
+	// the file and rank difference.
+	Square corner = weakKing;
+	if (!Square::same_color(bishop, Square(Square::underlying::SQ_A1))) {
+		corner = Square(weakKing.index() ^ 7);
+	}
+	int file = corner.file();
+	int rank = corner.rank();
+	int towardsCorner = 20 * (7 - std::abs(file - rank));
+
+	return KNOWN_WIN + BISHOP_VALUE + KNIGHT_VALUE + pushToEdge(weakKing) + towardsCorner + pushClose(strongKing, weakKing);
+}
+
+int evaluateKPK(const SearchBoard& board, Color strong) {
+	Square strongKing = board.kingSq(strong);
+	Square weakKing = board.kingSq(~strong);
+	Square pawn = board.pieces(PieceType::PAWN, strong).lsb();
+	Color sideToMove = board.sideToMove() == strong ? Color::WHITE : Color::BLACK;
+
+	// Normalize to white with the pawn on files a to d
+	if (strong == Color::BLACK) {
+		strongKing.flip();
+		weakKing.flip();
+		pawn.flip();
+	}
+	if (pawn.file() >= File::FILE_E) {
+		strongKing = Square(strongKing.index() ^ 7);
+		weakKing = Square(weakKing.index() ^ 7);
+		pawn = Square(pawn.index() ^ 7);
+	}
+
+	if (!probeKPK(strongKing, pawn, weakKing, sideToMove)) {
+		return 0;
+	}
+	int rank = pawn.rank();
+	return KNOWN_WIN + PAWN_VALUE + rank;
+}
+
+// KPK bitbase, built by retrograde iteration the first time it's probed.
+// Positions are indexed by side to move, both kings and the pawn on files a
+// to d, ranks 2 to 7: 2 * 64 * 64 * 24 entries.
+
+const int KPK_SIZE = 2 * 64 * 64 * 24;
+
+enum KPKResult : uint8_t {
+	KPK_INVALID = 0,
+	KPK_UNKNOWN = 1,
+	KPK_DRAW = 2,
+	KPK_WIN = 4
+};
+
+static int kpkIndex(int sideToMove, int blackKing, int whiteKing, int pawn) {
+	return whiteKing | (blackKing << 6) | (sideToMove << 12) | ((pawn & 7) << 13) | ((6 - pawn / 8) << 15);
+}
+
+static void kpkDecode(int index, int& sideToMove, int& blackKing, int& whiteKing, int& pawn) {
+	whiteKing = index & 63;
+	blackKing = (index >> 6) & 63;
+	sideToMove = (index >> 12) & 1;
+	pawn = (6 - (index >> 15)) * 8 + ((index >> 13) & 3);
+}
+
+static uint8_t kpkInitial(int sideToMove, int blackKing, int whiteKing, int pawn) {
+	Bitboard whiteKingAttacks = attacks::king(Square(whiteKing));
+	Bitboard blackKingAttacks = attacks::king(Square(blackKing));
+	Bitboard pawnAttacks = attacks::pawn(Color::WHITE, Square(pawn));
+	int push = pawn + 8;
+
+	if (Square::distance(Square(whiteKing), Square(blackKing)) <= 1 || whiteKing == pawn || blackKing == pawn
+		|| (sideToMove == 0 && (pawnAttacks & Bitboard::fromSquare(blackKing)))) {
+		return KPK_INVALID;
+	}
+	// Promotes without the new queen being taken for free
+	if (sideToMove == 0 && pawn / 8 == 6 && whiteKing != push
+		&& (Square::distance(Square(blackKing), Square(push)) > 1 || Square::distance(Square(whiteKing), Square(push)) == 1)) {
+		return KPK_WIN;
+	}
+	// Stalemate, or the pawn falls
+	if (sideToMove == 1 && (!(blackKingAttacks & ~(whiteKingAttacks | pawnAttacks))
+		|| (blackKingAttacks & ~whiteKingAttacks & Bitboard::fromSquare(pawn)))) {
+		return KPK_DRAW;
+	}
+	return KPK_UNKNOWN;
+}
+
+static uint8_t kpkClassify(const std::vector<uint8_t>& table, int index) {
+	int sideToMove, blackKing, whiteKing, pawn;
+	kpkDecode(index, sideToMove, blackKing, whiteKing, pawn);
+
+	// White needs one winning move, black one drawing move
+	uint8_t good = sideToMove == 0 ? KPK_WIN : KPK_DRAW;
+	uint8_t bad = sideToMove == 0 ? KPK_DRAW : KPK_WIN;
+	uint8_t results = KPK_INVALID;
+
+	Bitboard kingMoves = attacks::king(Square(sideToMove == 0 ? whiteKing : blackKing));
+	while (kingMoves) {
+		int to = kingMoves.pop();
+		results |= sideToMove == 0 ? table[kpkIndex(1, blackKing, to, pawn)] : table[kpkIndex(0, to, whiteKing, pawn)];
+	}
+	if (sideToMove == 0) {
+		if (pawn / 8 < 6) {
+			results |= table[kpkIndex(1, blackKing, whiteKing, pawn + 8)];
+		}
+		if (pawn / 8 == 1 && pawn + 8 != whiteKing && pawn + 8 != blackKing) {
+			results |= table[kpkIndex(1, blackKing, whiteKing, pawn + 16)];
+		}
+	}
+
+	if (results & good) {
+		return good;
+	}
+	return (results & KPK_UNKNOWN) ? uint8_t(KPK_UNKNOWN) : bad;
+}
+
+static std::vector<uint8_t> buildKPK() {
+	std::vector<uint8_t> table(KPK_SIZE);
+	for (int index = 0; index < KPK_SIZE; index++) {
+		int sideToMove, blackKing, whiteKing, pawn;
+		kpkDecode(index, sideToMove, blackKing, whiteKing, pawn);
+		table[index] = kpkInitial(sideToMove, blackKing, whiteKing, pawn);
+	}
+
+	bool changed = true;
+	while (changed) {
+		changed = false;
+		for (int index = 0; index < KPK_SIZE; index++) {
+			if (table[index] == KPK_UNKNOWN) {
+				table[index] = kpkClassify(table, index);
+				changed |= table[index] != KPK_UNKNOWN;
+			}
+		}
+	}
+	return table;
+}
+
+bool probeKPK(Square whiteKing, Square pawn, Square blackKing, Color sideToMove) {
+	static const std::vector<uint8_t> table = buildKPK();
+	int side = sideToMove == Color::WHITE ? 0 : 1;
+	return table[kpkIndex(side, blackKing.index(), whiteKing.index(), pawn.index())] == KPK_WIN;
+}
@@ -0,0 +1,22 @@
+#pragma once
+
+#include "searchboard.hpp"
+
+// Score for a position that is won but not yet a forced mate in the search.
+// Well below MATE_BOUND, so a real mate always sorts above it.
+const int KNOWN_WIN = 10000;
+
+// Evaluators for endgames whose outcome is known from the material alone.
+// Scores are from the strong side's point of view.
+using EndgameFunction = int (*)(const SearchBoard& board, Color strong);
+
+// King and enough material to force mate against a bare king
+int evaluateKXK(const SearchBoard& board, Color strong);
+// King, bishop and knight against a bare king
+int evaluateKBNK(const SearchBoard& board, Color strong);
+// King and pawn against a bare king, exact through a bitbase
+int evaluateKPK(const SearchBoard& board, Color strong);
+
+// Whether white wins with king and pawn against king. The pawn must be on
+// files a to d; other positions have to be mirrored first.
+bool probeKPK(Square whiteKing, Square pawn, Square blackKing, Color sideToMove);
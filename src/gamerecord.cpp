@@ -0,0 +1,45 @@
+#include "gamerecord.hpp"
+#include <stdexcept>
+
+GameRecord::GameRecord(const std::vector<std::string>& san, const Board& start) : start(start) {
+	moves.reserve(san.size());
+	keys.reserve(san.size() + 1);
+	Board board = start;
+	for (const std::string& text : san) {
+		Move move = uci::parseSan(board, text);
+		if (move == Move::NO_MOVE) {
+			throw std::runtime_error("illegal move " + text);
+		}
+		keys.push_back(board.hash());
+		moves.push_back(move);
+		board.makeMove(move);
+	}
+	keys.push_back(board.hash());
+	analysis.resize(moves.size());
+}
+
+// A copy of the board would bring along the states of every move before it,
+// making the copies quadratic in the game's length. The search never looks
+// at them, so each position is set up from its FEN instead.
+std::vector<Board> GameRecord::positions() const {
+	std::vector<Board> positions;
+	positions.reserve(moves.size());
+	Board board = start;
+	for (Move move : moves) {
+		positions.emplace_back(board.getFen());
+		board.makeMove(move);
+	}
+	return positions;
+}
+
+void GameRecord::markBook(const OpeningBook& book) {
+	for (size_t ply = 0; ply < moves.size(); ply++) {
+		// A Polyglot book's last moves lead to positions it has no entry for
+		if (book.contains(keys[ply + 1]) || book.hasMove(keys[ply], moves[ply])) {
+			analysis[ply].flags |= ANALYSIS_BOOK;
+		}
+		else {
+			analysis[ply].flags &= ~ANALYSIS_BOOK;
+		}
+	}
+}
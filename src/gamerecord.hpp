@@ -0,0 +1,62 @@
+#pragma once
+
+#include "chess.hpp"
+#include "openingbook.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace chess;
+
+enum Classification : uint8_t {
+	None,
+	Book, // Brown
+	Good, // Green
+	Miss, // Yellow Question Mark
+	Mistake, // Orange Question & Exclamation Mark
+	Blunder, // Red Double Question Mark
+	Brilliant // Turquoise Double Exclamation Mark
+};
+
+// The move is in the opening book, or leads to a position that is
+const uint8_t ANALYSIS_BOOK = 1;
+// Deeper analysis could still change the ply
+const uint8_t ANALYSIS_PROVISIONAL = 2;
+
+// Everything the review knows about one ply, in 8 bytes
+struct PlyAnalysis {
+	Move bestMove = Move::NO_MOVE;
+	// After the move, from white's point of view
+	int16_t evaluation = 0;
+	Classification cl = None;
+	uint8_t flags = 0;
+};
+
+// A game parsed once from SAN. Every later stage works from the moves and
+// keys here rather than from the move text.
+class GameRecord {
+public:
+	GameRecord() = default;
+	// Throws std::runtime_error on a move that doesn't parse or isn't legal
+	explicit GameRecord(const std::vector<std::string>& san, const Board& start = Board());
+
+	size_t size() const { return moves.size(); }
+	Color sideToMove(size_t ply) const { return (ply % 2 == 0) == (start.sideToMove() == Color::WHITE) ? Color::WHITE : Color::BLACK; }
+	// The position before every move, for searching them side by side. They
+	// are set up from FEN and don't carry the moves before them.
+	std::vector<Board> positions() const;
+
+	// Flags the plies that are book moves or reach a book position
+	void markBook(const OpeningBook& book);
+	bool inBook(size_t ply) const { return analysis[ply].flags & ANALYSIS_BOOK; }
+	// Evaluation after the move from `player`'s point of view
+	int evaluation(size_t ply, Color player) const {
+		return player == Color::WHITE ? analysis[ply].evaluation : -analysis[ply].evaluation;
+	}
+
+	Board start;
+	std::vector<Move> moves;
+	// Zobrist key before each move, then of the final position
+	std::vector<uint64_t> keys;
+	std::vector<PlyAnalysis> analysis;
+};
@@ -0,0 +1,42 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+
+// Random keys for the partial position hashes kept by SearchBoard. The
+// library's own Zobrist tables are private, so these come from a fixed
+// splitmix64 stream generated at compile time.
+
+constexpr uint64_t splitmix64(uint64_t& state) {
+	uint64_t z = (state += 0x9E3779B97F4A7C15ULL);
+	z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+	z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+	return z ^ (z >> 31);
+}
+
+// Indexed by [color][square]
+constexpr std::array<std::array<uint64_t, 64>, 2> PAWN_KEYS = [] {
+	std::array<std::array<uint64_t, 64>, 2> keys = {};
+	uint64_t state = 0x5041574E4B455953ULL;
+	for (auto& side : keys) {
+		for (uint64_t& key : side) {
+			key = splitmix64(state);
+		}
+	}
+	return keys;
+}();
+
+// Indexed by [piece][count of that piece before it was added], so the key
+// only depends on how many of each piece are on the board
+const int MATERIAL_KEY_COUNTS = 16;
+
+constexpr std::array<std::array<uint64_t, MATERIAL_KEY_COUNTS>, 12> MATERIAL_KEYS = [] {
+	std::array<std::array<uint64_t, MATERIAL_KEY_COUNTS>, 12> keys = {};
+	uint64_t state = 0x4D4154455249414CULL;
+	for (auto& piece : keys) {
+		for (uint64_t& key : piece) {
+			key = splitmix64(state);
+		}
+	}
+	return keys;
+}();
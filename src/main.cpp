@@ -4,10 +4,19 @@
 #include <fstream>
 #include <asio.hpp>
 #include <asio/ssl.hpp>
+#include "analysiscache.hpp"
 #include "bot.hpp"
-#include <unordered_set>
-
-const int SEARCH_DEPTH = 3;
+#include "nnue.hpp"
+#include "review.hpp"
+#include <atomic>
+#include <thread>
+
+const int SEARCH_MAX_DEPTH = 32;
+// Time for reviewing the whole game, shared out between the plies
+const int64_t REVIEW_TIME_MS = 10000;
+const uint64_t SEARCH_NODES = 0;
+// 0 uses every hardware thread
+const int SEARCH_THREADS = 0;
 const int SQUARE_SIZE = 100;
 
 std::string getUsername() {
@@ -138,156 +147,6 @@ std::vector<std::string> parsePGN(const std::string& pgn) {
     return moves;
 }
 
-struct EvaluatedMove {
-    std::string move;
-    int evaluation;
-};
-
-enum Classification {
-    None,
-    Book, // Brown
-    Good, // Green
-    Miss, // Yellow Question Mark
-    Mistake, // Orange Question & Exclamation Mark
-    Blunder, // Red Double Question Mark
-    Brilliant // Turquoise Double Exclamation Mark
-};
-
-struct ClassifiedMove {
-    std::string move;
-    Classification cl;
-};
-
-bool isBookMove(Board board, std::string move, const std::unordered_set<std::string>& book) {
-    board.makeMove(uci::parseSan(board, move));
-    if(book.find(board.getFen()) != book.end()) {
-        return true;
-    }else{
-        return false;
-    }
-}
-
-bool isMiss(Board board, int moveIndex, const std::vector<EvaluatedMove>& evaluatedMoves) {
-    if(moveIndex < 2) {
-        return false;
-    }
-
-    int eval = evaluatedMoves[moveIndex].evaluation;
-    int pEval = evaluatedMoves[moveIndex - 1].evaluation;
-    int ppEval = evaluatedMoves[moveIndex - 2].evaluation;
-
-    if(ppEval < pEval && (eval < pEval && eval >= ppEval)) {
-        return true;
-    }
-
-    return false;
-}
-
-bool isMistake(Board board, int moveIndex, const std::vector<EvaluatedMove>& evaluatedMoves) {
-    if(moveIndex < 1) {
-        return false;
-    }
-
-    int pEval = evaluatedMoves[moveIndex - 1].evaluation;
-    int eval = evaluatedMoves[moveIndex].evaluation;
-
-    if (eval - pEval == -1) {
-        return true;
-    }
-    return false;
-}
-
-bool isBlunder(Board board, int moveIndex, const std::vector<EvaluatedMove>& evaluatedMoves) {
-    if(moveIndex < 1) {
-        return false;
-    }
-
-    int pEval = evaluatedMoves[moveIndex - 1].evaluation;
-    int eval = evaluatedMoves[moveIndex].evaluation;
-
-    if (eval - pEval < -1) {
-        return true;
-    }
-    return false;
-}
-
-bool isBrilliant(Board board, int moveIndex, const std::vector<EvaluatedMove>& evaluatedMoves) {
-    Move move = uci::parseSan(board, evaluatedMoves[moveIndex].move);
-
-    int pEval = evaluatedMoves[moveIndex - 1].evaluation;
-    int eval = evaluatedMoves[moveIndex].evaluation;
-
-    if(board.isAttacked(move.to(), ~board.sideToMove()) && !board.isAttacked(move.to(), board.sideToMove()) && getPieceValue(board.at(move.from()).type()) > getPieceValue(board.at(move.to()).type()) && eval >= pEval) {
-        return true;
-    }
-    return false;
-}
-
-void evaluateAllMoves(const std::vector<std::string>& moves, std::vector<EvaluatedMove>& evaluatedMoves, std::vector<Move>& bestMoves, bool white) {
-    Board board;
-    for(int i = 0; i < moves.size(); i++) {
-        EvaluatedMove move;
-        move.move = moves[i];
-        
-        Move boardMove = uci::parseSan(board, move.move);
-        Move bestMove = findBestMove(board, SEARCH_DEPTH);
-        bestMoves.push_back(bestMove);
-        board.makeMove(boardMove);
-        int eval = search(board, SEARCH_DEPTH, 0, -KING_VALUE, KING_VALUE);
-        if(i % 2 != white) {
-            eval = -eval;
-        }
-        move.evaluation = eval;
-
-
-        evaluatedMoves.push_back(move);
-    }
-}
-
-void loadOpeningBook(std::unordered_set<std::string>& book) {
-    std::ifstream is("opening_book.txt");
-    if(is.fail()) {
-        std::cerr << "Failed to load opening book" << std::endl;
-    }
-    std::string fen;
-    while (std::getline(is, fen)) {
-        book.insert(fen);
-    }
-    is.close();
-}
-
-void classifyMoves(const std::vector<EvaluatedMove>& evaluatedMoves, const std::unordered_set<std::string>& book, std::vector<ClassifiedMove>& classifiedMoves, bool white) {
-    Board board;
-    for(int i = 0; i < evaluatedMoves.size(); i++) {
-        ClassifiedMove move;
-        move.move = evaluatedMoves[i].move;
-
-        if(i % 2 == white) {
-            // Dont classify
-            move.cl = None;
-        }else{
-            // Classify
-            if(isBookMove(board, evaluatedMoves[i].move, book)) {
-                move.cl = Book;
-            }else if(isMiss(board, i, evaluatedMoves)) {
-                move.cl = Miss;
-            }else if(isMistake(board, i, evaluatedMoves)) {
-                move.cl = Mistake;
-            }else if(isBlunder(board, i, evaluatedMoves)) {
-                move.cl = Blunder;
-            }else if(isBrilliant(board, i, evaluatedMoves)) {
-                move.cl = Brilliant;
-            }else{
-                move.cl = Good;
-            }
-        }
-
-
-        classifiedMoves.push_back(move);
-        board.makeMove(uci::parseSan(board, evaluatedMoves[i].move));
-    }
-}
-
 void drawBoard(sf::RenderWindow& window) {
     for(int i = 0; i < 8; i++) {
         for(int j = 0; j < 8; j++) {
@@ -371,8 +230,8 @@ sf::Texture* loadIcon(std::string iconName) {
     return texture;
 }
 
-void drawIcon(sf::RenderWindow& window, Square square, Classification cl, sf::Texture* icons[], bool white) {
-    sf::RectangleShape rect;
+// Centre of the classification icon in the top right corner of a square
+sf::Vector2f iconPosition(Square square, bool white) {
     int x = square.file();
     int y = 7 - square.rank();
     if(!white) {
@@ -396,15 +255,33 @@ void drawIcon(sf::RenderWindow& window, Square square, Classification cl, sf::Te
             yPos += 16;
         }
     }
-    
+    return sf::Vector2f(xPos, yPos);
+}
 
+// Provisional classifications are faded until the deeper pass settles them
+void drawIcon(sf::RenderWindow& window, Square square, Classification cl, sf::Texture* icons[], bool white, bool provisional) {
+    sf::RectangleShape rect;
     rect.setOrigin(sf::Vector2f(16, 16));
-    rect.setPosition(sf::Vector2f(xPos, yPos));
+    rect.setPosition(iconPosition(square, white));
     rect.setSize(sf::Vector2f(32, 32));
     rect.setTexture(icons[cl-1]);
+    if(provisional) {
+        rect.setFillColor(sf::Color(255, 255, 255, 140));
+    }
     window.draw(rect);
 }
 
+// Grey dot in place of the icon while the move is still being analyzed
+void drawPending(sf::RenderWindow& window, Square square, bool white) {
+    sf::CircleShape circle(12);
+    circle.setOrigin(sf::Vector2f(12, 12));
+    circle.setPosition(iconPosition(square, white));
+    circle.setFillColor(sf::Color(128, 128, 128, 200));
+    circle.setOutlineColor(sf::Color(255, 255, 255, 200));
+    circle.setOutlineThickness(2);
+    window.draw(circle);
+}
+
 int main()
 {
     std::string username = getUsername();
@@ -421,22 +298,41 @@ int main()
         return -1;
     }
 
-    std::vector<std::string> moves = parsePGN(pgn);
+    GameRecord record;
+    try {
+        record = GameRecord(parsePGN(pgn));
+    } catch (const std::exception& e) {
+        std::cerr << "Failed to parse game moves: " << e.what() << std::endl;
+        return -1;
+    }
 
     bool white = isWhite(game, username);
 
-    // Evaluate every move
-    std::vector<EvaluatedMove> evaluatedMoves;
-    std::vector<Move> bestMoves;
-    evaluateAllMoves(moves, evaluatedMoves, bestMoves, white);
+    // Use the neural network evaluation when a weights file is present
+    if(nnueNetwork.load("nnue.bin")) {
+        std::cout << "Using NNUE evaluation (" << nnueNetwork.simdName() << ")" << std::endl;
+    }
 
-    // Load opening book
-    std::unordered_set<std::string> book;
-    loadOpeningBook(book);
+    // Endgame tables made with chessreview-tbgen
+    int tableCount = tablebases.load("tablebases");
+    if(tableCount > 0) {
+        std::cout << "Loaded " << tableCount << " endgame tablebases" << std::endl;
+    }
 
-    // Classify every other move based on whether we are playing black or white
-    std::vector<ClassifiedMove> classifiedMoves;
-    classifyMoves(evaluatedMoves, book, classifiedMoves, white);
+    // Positions analyzed in earlier runs. NNUE and the piece-square evaluation
+    // score differently, so they're cached as different versions.
+    uint16_t cacheVersion = ENGINE_VERSION * 2 + (nnueNetwork.loaded() ? 1 : 0);
+    if(!analysisCache.open("analysis.cache", cacheVersion)) {
+        std::cerr << "Failed to open analysis cache" << std::endl;
+    }
+
+    // Load opening book: a Polyglot book or one converted by
+    // chessreview-bookgen, or else the FENs
+    OpeningBook book;
+    if(!book.loadDefault()) {
+        std::cerr << "Failed to load opening book" << std::endl;
+    }
+    record.markBook(book);
 
     // Create window and start loop
     sf::RenderWindow window(sf::VideoMode({800, 800}), "ChessReview");
@@ -460,8 +356,20 @@ int main()
     icons[4] = loadIcon("blunder");
     icons[5] = loadIcon("brilliant");
 
+    // Review in the background and show the results as they come in
+    // The review thread owns the record's analysis from here on, this loop
+    // only reads the moves and gets the analysis through the channel
+    PlyChannel<PlyAnalysis> review(record.size());
+    std::atomic<bool> stopReview{false};
+    SearchLimits limits;
+    limits.maxDepth = SEARCH_MAX_DEPTH;
+    limits.nodes = SEARCH_NODES;
+    std::thread reviewThread(reviewGame, std::ref(record), white ? Color::WHITE : Color::BLACK, limits, REVIEW_TIME_MS, SEARCH_THREADS, std::ref(review), std::cref(stopReview));
+    std::string shownTitle = "ChessReview";
+
     Board board;
-    std::vector<Move> moveHistory;
+    // Moves of the record shown on the board
+    size_t ply = 0;
 
     while (window.isOpen())
     {
@@ -478,36 +386,67 @@ int main()
             } else if (event->is<sf::Event::KeyPressed>()) {
                 auto keyEvent = event->getIf<sf::Event::KeyPressed>();
                 if(keyEvent->code == sf::Keyboard::Key::Right) {
-                    if(moveHistory.size() < classifiedMoves.size()){
-                        Move move = uci::parseSan(board, classifiedMoves[moveHistory.size()].move);
-                        board.makeMove(move);
-                        moveHistory.push_back(move);
+                    if(ply < record.size()){
+                        board.makeMove(record.moves[ply]);
+                        ply++;
                     }
                 }else if(keyEvent->code == sf::Keyboard::Key::Left) {
-                    if(moveHistory.size() > 0) {
-                        board.unmakeMove(moveHistory.back());
-                        moveHistory.pop_back();
+                    if(ply > 0) {
+                        ply--;
+                        board.unmakeMove(record.moves[ply]);
                     }
                 }
             }
         }
 
+        std::string title = "ChessReview";
+        size_t progress = review.publishedCount();
+        if(progress < record.size()) {
+            title += " - analyzing " + std::to_string(progress) + "/" + std::to_string(record.size());
+        }else{
+            int provisional = 0;
+            for(size_t i = 0; i < record.size(); i++) {
+                PlyAnalysis analysis;
+                if(review.tryGet(i, analysis) && (analysis.flags & ANALYSIS_PROVISIONAL)) {
+                    provisional++;
+                }
+            }
+            if(provisional > 0) {
+                title += " - refining " + std::to_string(provisional) + " moves";
+            }
+        }
+        if(title != shownTitle) {
+            shownTitle = title;
+            window.setTitle(title);
+        }
+
         window.clear();
         drawBoard(window);
 
+        PlyAnalysis next;
+        if(review.tryGet(ply, next)) {
+            drawSquare(window, next.bestMove.from(), sf::Color(135, 245, 150, 150), white);
+            drawSquare(window, next.bestMove.to(), sf::Color(135, 245, 150, 150), white);
+        }
 
-        drawSquare(window, bestMoves[moveHistory.size()].from(), sf::Color(135, 245, 150, 150), white);
-        drawSquare(window, bestMoves[moveHistory.size()].to(), sf::Color(135, 245, 150, 150), white);
-
-        if(moveHistory.size() > 0) {
-            drawSquare(window, moveHistory.back().from(), sf::Color(245, 245, 130, 150), white);
-            drawSquare(window, moveHistory.back().to(), sf::Color(245, 245, 130, 150), white);
-            if(classifiedMoves[moveHistory.size()-1].cl != None) {
-                drawIcon(window, moveHistory.back().to(), classifiedMoves[moveHistory.size()-1].cl, icons, white);
+        if(ply > 0) {
+            Move lastMove = record.moves[ply - 1];
+            drawSquare(window, lastMove.from(), sf::Color(245, 245, 130, 150), white);
+            drawSquare(window, lastMove.to(), sf::Color(245, 245, 130, 150), white);
+            PlyAnalysis last;
+            if(!review.tryGet(ply - 1, last)) {
+                drawPending(window, lastMove.to(), white);
+            }else if(last.cl != None) {
+                drawIcon(window, lastMove.to(), last.cl, icons, white, last.flags & ANALYSIS_PROVISIONAL);
             }
         }
 
         drawPieces(window, board, &piecesTexture, white);
         window.display();
     }
-}
\ No newline at end of file
+
+    // Searches already running finish within their time limit
+    stopReview = true;
+    reviewThread.join();
+    analysisCache.close();
+}
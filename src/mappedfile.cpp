@@ -0,0 +1,179 @@
+#include "mappedfile.hpp"
+
+#ifdef _WIN32
+#ifndef NOMINMAX
+#define NOMINMAX
+#endif
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+MappedFile::~MappedFile() {
+	close();
+}
+
+#ifdef _WIN32
+
+bool MappedFile::open(const std::string& path) {
+	close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mappingObject = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mappingObject) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mappingObject, FILE_MAP_READ, 0, 0, 0);
+	if (!view) {
+		CloseHandle(mappingObject);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mappingObject;
+	mapping = static_cast<uint8_t*>(view);
+	length = size_t(fileSize.QuadPart);
+	return true;
+}
+
+bool MappedFile::openWritable(const std::string& path, size_t size) {
+	close();
+
+	HANDLE file = CreateFileA(path.c_str(), GENERIC_READ | GENERIC_WRITE, FILE_SHARE_READ, nullptr, OPEN_ALWAYS,
+		FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr);
+	if (file == INVALID_HANDLE_VALUE) {
+		return false;
+	}
+
+	LARGE_INTEGER fileSize;
+	fileSize.QuadPart = LONGLONG(size);
+	if (size == 0 || !SetFilePointerEx(file, fileSize, nullptr, FILE_BEGIN) || !SetEndOfFile(file)) {
+		CloseHandle(file);
+		return false;
+	}
+
+	HANDLE mappingObject = CreateFileMappingA(file, nullptr, PAGE_READWRITE, 0, 0, nullptr);
+	if (!mappingObject) {
+		CloseHandle(file);
+		return false;
+	}
+
+	void* view = MapViewOfFile(mappingObject, FILE_MAP_WRITE, 0, 0, 0);
+	if (!view) {
+		CloseHandle(mappingObject);
+		CloseHandle(file);
+		return false;
+	}
+
+	fileHandle = file;
+	mappingHandle = mappingObject;
+	mapping = static_cast<uint8_t*>(view);
+	length = size;
+	writable = true;
+	return true;
+}
+
+void MappedFile::close() {
+	if (mapping) {
+		UnmapViewOfFile(mapping);
+		CloseHandle(mappingHandle);
+		CloseHandle(fileHandle);
+	}
+	mapping = nullptr;
+	mappingHandle = nullptr;
+	fileHandle = nullptr;
+	length = 0;
+	writable = false;
+}
+
+void MappedFile::flush() {
+	if (writable) {
+		FlushViewOfFile(mapping, 0);
+	}
+}
+
+#else
+
+bool MappedFile::open(const std::string& path) {
+	close();
+
+	int fd = ::open(path.c_str(), O_RDONLY);
+	if (fd < 0) {
+		return false;
+	}
+
+	struct stat info;
+	if (fstat(fd, &info) != 0 || info.st_size == 0) {
+		::close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, size_t(info.st_size), PROT_READ, MAP_SHARED, fd, 0);
+	// The mapping stays valid after the descriptor is closed
+	::close(fd);
+	if (view == MAP_FAILED) {
+		return false;
+	}
+
+	mapping = static_cast<uint8_t*>(view);
+	length = size_t(info.st_size);
+	return true;
+}
+
+bool MappedFile::openWritable(const std::string& path, size_t size) {
+	close();
+
+	int fd = ::open(path.c_str(), O_RDWR | O_CREAT, 0644);
+	if (fd < 0) {
+		return false;
+	}
+	if (size == 0 || ftruncate(fd, off_t(size)) != 0) {
+		::close(fd);
+		return false;
+	}
+
+	void* view = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+	::close(fd);
+	if (view == MAP_FAILED) {
+		return false;
+	}
+
+	mapping = static_cast<uint8_t*>(view);
+	length = size;
+	writable = true;
+	return true;
+}
+
+void MappedFile::close() {
+	if (mapping) {
+		munmap(mapping, length);
+	}
+	mapping = nullptr;
+	length = 0;
+	writable = false;
+}
+
+void MappedFile::flush() {
+	if (writable) {
+		msync(mapping, length, MS_ASYNC);
+	}
+}
+
+#endif
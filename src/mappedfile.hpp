@@ -0,0 +1,41 @@
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+// Memory mapping of a whole file. Pages are loaded by the OS on first touch
+// and shared between processes mapping the same file.
+class MappedFile {
+public:
+	MappedFile() = default;
+	~MappedFile();
+
+	MappedFile(const MappedFile&) = delete;
+	MappedFile& operator=(const MappedFile&) = delete;
+
+	// Read-only. Returns false if the file is missing, empty or can't be mapped
+	bool open(const std::string& path);
+	// Read-write, creating the file or resizing it to `size` bytes first.
+	// Changes reach the file when the OS writes the pages back.
+	bool openWritable(const std::string& path, size_t size);
+	void close();
+
+	// Starts writing changed pages back without waiting for it
+	void flush();
+
+	bool isOpen() const { return mapping != nullptr; }
+	const uint8_t* data() const { return mapping; }
+	// Null unless opened writable
+	uint8_t* writableData() const { return writable ? mapping : nullptr; }
+	size_t size() const { return length; }
+
+private:
+	uint8_t* mapping = nullptr;
+	size_t length = 0;
+	bool writable = false;
+#ifdef _WIN32
+	void* fileHandle = nullptr;
+	void* mappingHandle = nullptr;
+#endif
+};
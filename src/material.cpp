@@ -0,0 +1,117 @@
+#include "material.hpp"
+#include "bot.hpp"
+
+const int BISHOP_PAIR_MG = 30;
+const int BISHOP_PAIR_EG = 50;
+// Knights get better and rooks worse the more pawns are left
+const int KNIGHT_PAWN_BONUS = 6;
+const int ROOK_PAWN_BONUS = -12;
+
+struct SideMaterial {
+	int pawns = 0;
+	int knights = 0;
+	int bishops = 0;
+	int rooks = 0;
+	int queens = 0;
+
+	int pieces() const {
+		return knights + bishops + rooks + queens;
+	}
+
+	int nonPawnMaterial() const {
+		return knights * KNIGHT_VALUE + bishops * BISHOP_VALUE + rooks * ROOK_VALUE + queens * QUEEN_VALUE;
+	}
+};
+
+static SideMaterial countSide(const SearchBoard& board, Color side) {
+	SideMaterial material;
+	material.pawns = board.count(Piece(PieceType::PAWN, side));
+	material.knights = board.count(Piece(PieceType::KNIGHT, side));
+	material.bishops = board.count(Piece(PieceType::BISHOP, side));
+	material.rooks = board.count(Piece(PieceType::ROOK, side));
+	material.queens = board.count(Piece(PieceType::QUEEN, side));
+	return material;
+}
+
+static int imbalance(const SideMaterial& us, int phase) {
+	int midgame = 0;
+	int endgame = 0;
+	if (us.bishops >= 2) {
+		midgame += BISHOP_PAIR_MG;
+		endgame += BISHOP_PAIR_EG;
+	}
+	int pawnAdjustment = us.knights * (us.pawns - 5) * KNIGHT_PAWN_BONUS + us.rooks * (us.pawns - 5) * ROOK_PAWN_BONUS;
+	return taper(midgame + pawnAdjustment, endgame + pawnAdjustment, phase);
+}
+
+// How much of the evaluation the side can expect to convert
+static int scaleFor(const SideMaterial& us, const SideMaterial& them) {
+	if (us.pawns) {
+		return SCALE_NORMAL;
+	}
+	// Two knights can't force mate
+	if (us.pieces() == us.knights && us.knights <= 2 && them.pieces() == 0 && them.pawns == 0) {
+		return 0;
+	}
+	// Up less than a rook's worth without pawns is usually a draw
+	if (us.nonPawnMaterial() - them.nonPawnMaterial() <= BISHOP_VALUE) {
+		if (us.nonPawnMaterial() < ROOK_VALUE) {
+			return 0;
+		}
+		return them.nonPawnMaterial() <= BISHOP_VALUE ? 4 : 14;
+	}
+	return SCALE_NORMAL;
+}
+
+static EndgameFunction endgameFor(const SideMaterial& strong, const SideMaterial& weak) {
+	if (weak.pieces() || weak.pawns) {
+		return nullptr;
+	}
+	if (strong.pawns == 0 && strong.knights == 1 && strong.bishops == 1 && strong.rooks == 0 && strong.queens == 0) {
+		return evaluateKBNK;
+	}
+	if (strong.pawns == 1 && strong.pieces() == 0) {
+		return evaluateKPK;
+	}
+	if (strong.queens || strong.rooks || strong.bishops >= 2 || (strong.bishops && strong.knights)) {
+		return evaluateKXK;
+	}
+	return nullptr;
+}
+
+MaterialTable::MaterialTable() : entries(new MaterialEntry[MATERIAL_TABLE_ENTRIES]) {
+	// Same trick as the pawn table: a key that can't map to its own slot
+	for (size_t i = 0; i < MATERIAL_TABLE_ENTRIES; i++) {
+		entries[i].key = ~uint64_t(i);
+	}
+}
+
+const MaterialEntry& MaterialTable::probe(const SearchBoard& board) {
+	uint64_t key = board.materialKey();
+	MaterialEntry& entry = entries[key & (MATERIAL_TABLE_ENTRIES - 1)];
+	if (entry.key == key) {
+		return entry;
+	}
+
+	SideMaterial white = countSide(board, Color::WHITE);
+	SideMaterial black = countSide(board, Color::BLACK);
+
+	entry = MaterialEntry();
+	entry.key = key;
+	entry.imbalance = int16_t(imbalance(white, board.phase()) - imbalance(black, board.phase()));
+	entry.scale[0] = uint8_t(scaleFor(white, black));
+	entry.scale[1] = uint8_t(scaleFor(black, white));
+	entry.loneBishops = white.pieces() == 1 && white.bishops == 1 && black.pieces() == 1 && black.bishops == 1;
+
+	if (EndgameFunction endgame = endgameFor(white, black)) {
+		entry.endgame = endgame;
+		entry.strongSide = Color::WHITE;
+	}
+	else if (EndgameFunction endgame = endgameFor(black, white)) {
+		entry.endgame = endgame;
+		entry.strongSide = Color::BLACK;
+	}
+	entry.bishopsOnly[0] = white.bishops >= 2 && white.pieces() == white.bishops;
+	entry.bishopsOnly[1] = black.bishops >= 2 && black.pieces() == black.bishops;
+	return entry;
+}
@@ -0,0 +1,40 @@
+#pragma once
+
+#include "endgame.hpp"
+#include <cstdint>
+#include <memory>
+
+const size_t MATERIAL_TABLE_ENTRIES = 1 << 13;
+
+// Scale factors are out of SCALE_NORMAL and shrink the evaluation of the side
+// that is ahead in endgames that are hard or impossible to win
+const int SCALE_NORMAL = 64;
+const int SCALE_OPPOSITE_BISHOPS = 32;
+
+// Everything that depends only on which pieces are on the board
+struct MaterialEntry {
+	uint64_t key = 0;
+	// Tapered imbalance terms, white relative
+	int16_t imbalance = 0;
+	uint8_t scale[2] = {SCALE_NORMAL, SCALE_NORMAL};
+	// Each side has one bishop and otherwise only pawns, so the bishops'
+	// square colours decide whether the opposite bishop scale applies
+	bool loneBishops = false;
+	// Each side's only pieces are two or more bishops, which can only force
+	// mate from both square colours. Indexed like scale.
+	bool bishopsOnly[2] = {false, false};
+	// Set when the material has a dedicated evaluator
+	EndgameFunction endgame = nullptr;
+	Color strongSide = Color::WHITE;
+};
+
+// Per-thread cache of material evaluation keyed by the material hash
+class MaterialTable {
+public:
+	MaterialTable();
+
+	const MaterialEntry& probe(const SearchBoard& board);
+
+private:
+	std::unique_ptr<MaterialEntry[]> entries;
+};
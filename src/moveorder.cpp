@@ -0,0 +1,137 @@
+#include "moveorder.hpp"
+#include <algorithm>
+#include <cstdlib>
+
+MoveOrdering::MoveOrdering() {
+	clear();
+}
+
+void MoveOrdering::clear() {
+	for (auto& plyKillers : killers) {
+		plyKillers.fill(Move::NO_MOVE);
+	}
+	for (auto& side : history) {
+		for (auto& from : side) {
+			from.fill(0);
+		}
+	}
+	for (auto& piece : counterMoves) {
+		piece.fill(Move::NO_MOVE);
+	}
+}
+
+static void ageHistory(std::array<std::array<std::array<int16_t, 64>, 64>, 2>& history) {
+	for (auto& side : history) {
+		for (auto& from : side) {
+			for (auto& value : from) {
+				value /= 2;
+			}
+		}
+	}
+}
+
+// Killers only make sense within one search tree, history and countermoves
+// carry over at half weight.
+void MoveOrdering::newSearch() {
+	for (auto& plyKillers : killers) {
+		plyKillers.fill(Move::NO_MOVE);
+	}
+	ageHistory(history);
+}
+
+// The new root was at ply 1 of the last tree, so every killer moves up a ply
+void MoveOrdering::advance() {
+	std::move(killers.begin() + 1, killers.end(), killers.begin());
+	killers.back().fill(Move::NO_MOVE);
+	ageHistory(history);
+}
+
+static bool isQuiet(const Board& board, Move move) {
+	return !board.isCapture(move) && move.typeOf() != Move::PROMOTION;
+}
+
+int MoveOrdering::captureScore(const Board& board, Move move) const {
+	int attacker = board.at<PieceType>(move.from());
+	int victim = move.typeOf() == Move::ENPASSANT ? int(PieceType::PAWN) : int(board.at<PieceType>(move.to()));
+	int score = CAPTURE_SCORE;
+	if (board.isCapture(move)) {
+		score += MVV_LVA[victim][attacker];
+	}
+	if (move.typeOf() == Move::PROMOTION) {
+		score += MVV_LVA[int(move.promotionType())][int(PieceType::PAWN)];
+	}
+	return score;
+}
+
+Move MoveOrdering::counterMove(const Board& board, Move previousMove) const {
+	if (previousMove == Move::NO_MOVE || previousMove == Move::NULL_MOVE) {
+		return Move::NO_MOVE;
+	}
+	Piece piece = board.at(previousMove.to());
+	if (piece == Piece::NONE) {
+		return Move::NO_MOVE;
+	}
+	return counterMoves[int(piece)][previousMove.to().index()];
+}
+
+// Quiet promotions are scored like captures
+int MoveOrdering::quietScore(const Board& board, Move move, Move counter) const {
+	if (move.typeOf() == Move::PROMOTION) {
+		return captureScore(board, move);
+	}
+	if (move == counter) {
+		return COUNTER_MOVE_SCORE;
+	}
+	return history[board.sideToMove()][move.from().index()][move.to().index()];
+}
+
+void MoveOrdering::scoreMoves(const Board& board, Movelist& moves, Move hashMove, int ply, Move previousMove) const {
+	Move counter = counterMove(board, previousMove);
+
+	for (auto& move : moves) {
+		int score;
+		if (move == hashMove) {
+			score = HASH_MOVE_SCORE;
+		}
+		else if (!isQuiet(board, move)) {
+			score = captureScore(board, move);
+		}
+		else if (move == killers[ply][0]) {
+			score = KILLER_SCORE + 1;
+		}
+		else if (move == killers[ply][1]) {
+			score = KILLER_SCORE;
+		}
+		else {
+			score = quietScore(board, move, counter);
+		}
+		move.setScore(score);
+	}
+}
+
+// History gravity keeps every entry within [-HISTORY_MAX, HISTORY_MAX]
+static void updateHistory(int16_t& entry, int bonus) {
+	bonus = std::clamp(bonus, -HISTORY_MAX, HISTORY_MAX);
+	entry += bonus - entry * std::abs(bonus) / HISTORY_MAX;
+}
+
+void MoveOrdering::updateQuietCutoff(const Board& board, Move move, int depth, int ply, Move previousMove,
+	const Move* triedQuiets, int triedCount) {
+	if (killers[ply][0] != move) {
+		killers[ply][1] = killers[ply][0];
+		killers[ply][0] = move;
+	}
+
+	if (previousMove != Move::NO_MOVE && previousMove != Move::NULL_MOVE && board.at(previousMove.to()) != Piece::NONE) {
+		counterMoves[int(board.at(previousMove.to()))][previousMove.to().index()] = move;
+	}
+
+	int side = board.sideToMove();
+	int bonus = depth * depth;
+	updateHistory(history[side][move.from().index()][move.to().index()], bonus);
+	for (int i = 0; i < triedCount; i++) {
+		if (triedQuiets[i] != move) {
+			updateHistory(history[side][triedQuiets[i].from().index()][triedQuiets[i].to().index()], -bonus);
+		}
+	}
+}
@@ -0,0 +1,52 @@
+#pragma once
+
+#include "chess.hpp"
+#include "searchboard.hpp"
+#include <array>
+#include <cstdint>
+
+using namespace chess;
+
+// Move ordering scores fit in the int16 score of chess::Move, from the hash
+// move down to quiet moves ordered by history.
+const int HASH_MOVE_SCORE = 30000;
+const int CAPTURE_SCORE = 20000;
+const int KILLER_SCORE = 19000;
+const int COUNTER_MOVE_SCORE = 18000;
+const int HISTORY_MAX = 16000;
+
+// Piece values used only for ordering, indexed by PieceType
+constexpr int ORDERING_VALUE[6] = {1, 3, 3, 5, 9, 0};
+
+// Most valuable victim, least valuable attacker, indexed [victim][attacker]
+constexpr std::array<std::array<int, 6>, 6> MVV_LVA = [] {
+	std::array<std::array<int, 6>, 6> table{};
+	for (int victim = 0; victim < 6; victim++) {
+		for (int attacker = 0; attacker < 6; attacker++) {
+			table[victim][attacker] = ORDERING_VALUE[victim] * 16 - ORDERING_VALUE[attacker];
+		}
+	}
+	return table;
+}();
+
+// Per-thread ordering heuristics learned from beta cutoffs
+struct MoveOrdering {
+	std::array<std::array<Move, 2>, MAX_PLY + 1> killers;
+	std::array<std::array<std::array<int16_t, 64>, 64>, 2> history;
+	std::array<std::array<Move, 64>, 12> counterMoves;
+
+	MoveOrdering();
+
+	void clear();
+	void newSearch();
+	// Same for a search of a position right after the last root
+	void advance();
+
+	int captureScore(const Board& board, Move move) const;
+	int quietScore(const Board& board, Move move, Move counter) const;
+	void scoreMoves(const Board& board, Movelist& moves, Move hashMove, int ply, Move previousMove) const;
+
+	Move counterMove(const Board& board, Move previousMove) const;
+	void updateQuietCutoff(const Board& board, Move move, int depth, int ply, Move previousMove,
+		const Move* triedQuiets, int triedCount);
+};
@@ -0,0 +1,258 @@
+#include "movepicker.hpp"
+#include "see.hpp"
+#include <algorithm>
+
+// Checks a move from the transposition table or killer slots against the
+// position without generating moves. Castling and en passant are rare enough
+// to just look up in the generated moves of the king or the pawns.
+bool isLegalMove(const Board& board, Move move) {
+	if (move == Move::NO_MOVE || move == Move::NULL_MOVE) {
+		return false;
+	}
+	Color us = board.sideToMove();
+	Piece piece = board.at(move.from());
+	if (piece == Piece::NONE || piece.color() != us) {
+		return false;
+	}
+	if (move.typeOf() == Move::CASTLING || move.typeOf() == Move::ENPASSANT) {
+		Movelist moves;
+		movegen::legalmoves(moves, board, 1 << int(piece.type()));
+		return moves.find(move) != -1;
+	}
+
+	Square from = move.from();
+	Square to = move.to();
+	Piece target = board.at(to);
+	if (target != Piece::NONE && (target.color() == us || target.type() == PieceType::KING)) {
+		return false;
+	}
+
+	Bitboard occ = board.occ();
+	Bitboard toBB = Bitboard::fromSquare(to);
+	PieceType type = piece.type();
+	bool promotion = move.typeOf() == Move::PROMOTION;
+	if (!promotion && move.move() >> 12 != 0) {
+		return false;
+	}
+
+	if (type == PieceType::PAWN) {
+		bool lastRank = to.rank() == (us == Color::WHITE ? Rank::RANK_8 : Rank::RANK_1);
+		if (promotion != lastRank) {
+			return false;
+		}
+		int forward = us == Color::WHITE ? 8 : -8;
+		if (target == Piece::NONE) {
+			bool single = to.index() == from.index() + forward;
+			bool startRank = from.rank() == (us == Color::WHITE ? Rank::RANK_2 : Rank::RANK_7);
+			bool doublePush = startRank && to.index() == from.index() + 2 * forward &&
+				board.at(Square(from.index() + forward)) == Piece::NONE;
+			if (!single && !doublePush) {
+				return false;
+			}
+		}
+		else if (!(attacks::pawn(us, from) & toBB)) {
+			return false;
+		}
+	}
+	else {
+		if (promotion) {
+			return false;
+		}
+		Bitboard reach;
+		if (type == PieceType::KNIGHT) {
+			reach = attacks::knight(from);
+		}
+		else if (type == PieceType::BISHOP) {
+			reach = attacks::bishop(from, occ);
+		}
+		else if (type == PieceType::ROOK) {
+			reach = attacks::rook(from, occ);
+		}
+		else if (type == PieceType::QUEEN) {
+			reach = attacks::queen(from, occ);
+		}
+		else {
+			reach = attacks::king(from);
+		}
+		if (!(reach & toBB)) {
+			return false;
+		}
+	}
+
+	// The move is legal if our king isn't attacked once it has been made
+	Color them = ~us;
+	Bitboard after = (occ ^ Bitboard::fromSquare(from)) | toBB;
+	Square king = type == PieceType::KING ? to : board.kingSq(us);
+	Bitboard remaining = ~toBB;
+	Bitboard queens = board.pieces(PieceType::QUEEN, them);
+
+	if (attacks::pawn(us, king) & board.pieces(PieceType::PAWN, them) & remaining) {
+		return false;
+	}
+	if (attacks::knight(king) & board.pieces(PieceType::KNIGHT, them) & remaining) {
+		return false;
+	}
+	if (attacks::king(king) & board.pieces(PieceType::KING, them)) {
+		return false;
+	}
+	if (attacks::bishop(king, after) & (board.pieces(PieceType::BISHOP, them) | queens) & remaining) {
+		return false;
+	}
+	if (attacks::rook(king, after) & (board.pieces(PieceType::ROOK, them) | queens) & remaining) {
+		return false;
+	}
+	return true;
+}
+
+static bool isQuietMove(const Board& board, Move move) {
+	return !board.isCapture(move) && move.typeOf() != Move::PROMOTION;
+}
+
+// Moves the highest scored of the moves from index to end to position index
+// and returns it
+static Move pickBest(Movelist& moves, int index, int end) {
+	int best = index;
+	for (int i = index + 1; i < end; i++) {
+		if (moves[i].score() > moves[best].score()) {
+			best = i;
+		}
+	}
+	std::swap(moves[index], moves[best]);
+	return moves[index];
+}
+
+// Returns how many captures there are to pick from, with the one already
+// tried left out past them
+static int generateCaptures(const Board& board, const MoveOrdering& ordering, Movelist& captures, Move skip) {
+	movegen::legalmoves<movegen::MoveGenType::CAPTURE>(captures, board);
+	Move* end = std::remove(captures.begin(), captures.end(), skip);
+	for (Move* move = captures.begin(); move != end; move++) {
+		move->setScore(ordering.captureScore(board, *move));
+	}
+	return int(end - captures.begin());
+}
+
+MovePicker::MovePicker(const Board& board, const MoveOrdering& ordering, Move ttMove, int ply, Move previousMove)
+	: board(board), ordering(ordering), ttMove(ttMove), previousMove(previousMove) {
+	killers[0] = ordering.killers[ply][0];
+	killers[1] = ordering.killers[ply][1];
+}
+
+// Captures that lose material in the exchange are searched after the quiets
+bool MovePicker::isBadCapture(Move move) const {
+	return staticExchange(board, move) < 0;
+}
+
+Move MovePicker::next() {
+	switch (stage) {
+	case TT_MOVE:
+		stage = GENERATE_CAPTURES;
+		if (isLegalMove(board, ttMove)) {
+			return ttMove;
+		}
+		ttMove = Move::NO_MOVE;
+		[[fallthrough]];
+
+	case GENERATE_CAPTURES:
+		captureCount = generateCaptures(board, ordering, moves, ttMove);
+		stage = GOOD_CAPTURES;
+		index = 0;
+		[[fallthrough]];
+
+	case GOOD_CAPTURES:
+		while (index < captureCount) {
+			Move move = pickBest(moves, index++, captureCount);
+			if (isBadCapture(move)) {
+				badCaptures.add(move);
+				continue;
+			}
+			return move;
+		}
+		stage = FIRST_KILLER;
+		[[fallthrough]];
+
+	case FIRST_KILLER:
+		stage = SECOND_KILLER;
+		if (killers[0] != ttMove && isQuietMove(board, killers[0]) && isLegalMove(board, killers[0])) {
+			return killers[0];
+		}
+		killers[0] = Move::NO_MOVE;
+		[[fallthrough]];
+
+	case SECOND_KILLER:
+		stage = GENERATE_QUIETS;
+		if (killers[1] != ttMove && isQuietMove(board, killers[1]) && isLegalMove(board, killers[1])) {
+			return killers[1];
+		}
+		killers[1] = Move::NO_MOVE;
+		[[fallthrough]];
+
+	case GENERATE_QUIETS: {
+		// Every capture has been returned or set aside by now
+		movegen::legalmoves<movegen::MoveGenType::QUIET>(moves, board);
+		Move counter = ordering.counterMove(board, previousMove);
+		for (auto& move : moves) {
+			move.setScore(ordering.quietScore(board, move, counter));
+		}
+		stage = QUIETS;
+		index = 0;
+		[[fallthrough]];
+	}
+
+	case QUIETS:
+		while (index < moves.size()) {
+			Move move = pickBest(moves, index++, moves.size());
+			if (move == ttMove || move == killers[0] || move == killers[1]) {
+				continue;
+			}
+			return move;
+		}
+		stage = BAD_CAPTURES;
+		index = 0;
+		[[fallthrough]];
+
+	case BAD_CAPTURES:
+		if (index < badCaptures.size) {
+			return badCaptures.moves[index++];
+		}
+		stage = DONE;
+		[[fallthrough]];
+
+	case DONE:
+		return Move::NO_MOVE;
+	}
+	return Move::NO_MOVE;
+}
+
+CapturePicker::CapturePicker(const Board& board, const MoveOrdering& ordering, Move ttMove)
+	: board(board), ordering(ordering), ttMove(ttMove) {
+}
+
+Move CapturePicker::next() {
+	switch (stage) {
+	case TT_MOVE:
+		stage = GENERATE_CAPTURES;
+		if (board.isCapture(ttMove) && isLegalMove(board, ttMove)) {
+			return ttMove;
+		}
+		ttMove = Move::NO_MOVE;
+		[[fallthrough]];
+
+	case GENERATE_CAPTURES:
+		captureCount = generateCaptures(board, ordering, captures, ttMove);
+		stage = CAPTURES;
+		index = 0;
+		[[fallthrough]];
+
+	case CAPTURES:
+		if (index < captureCount) {
+			return pickBest(captures, index++, captureCount);
+		}
+		stage = DONE;
+		[[fallthrough]];
+
+	case DONE:
+		return Move::NO_MOVE;
+	}
+	return Move::NO_MOVE;
+}
@@ -0,0 +1,89 @@
+#pragma once
+
+#include "chess.hpp"
+#include "moveorder.hpp"
+
+using namespace chess;
+
+// No legal position has anywhere near this many captures, so the list the
+// losing ones wait in can be much smaller than the 256 entry chess::Movelist.
+const int MAX_CAPTURES = 128;
+
+template <int Capacity>
+struct ScoredMoveList {
+	Move moves[Capacity];
+	int size = 0;
+
+	void add(Move move) {
+		assert(size < Capacity);
+		moves[size++] = move;
+	}
+};
+
+using CaptureList = ScoredMoveList<MAX_CAPTURES>;
+
+bool isLegalMove(const Board& board, Move move);
+
+// Hands out the moves of a search node one at a time. Each stage is only
+// generated once the previous ones are exhausted, and moves are picked by
+// selection so a node that cuts off early never sorts the rest. Captures and
+// then quiets are generated into the same list, scored in place.
+class MovePicker {
+public:
+	MovePicker(const Board& board, const MoveOrdering& ordering, Move ttMove, int ply, Move previousMove);
+
+	// Returns Move::NO_MOVE once every legal move has been returned
+	Move next();
+
+private:
+	enum Stage {
+		TT_MOVE,
+		GENERATE_CAPTURES,
+		GOOD_CAPTURES,
+		FIRST_KILLER,
+		SECOND_KILLER,
+		GENERATE_QUIETS,
+		QUIETS,
+		BAD_CAPTURES,
+		DONE
+	};
+
+	bool isBadCapture(Move move) const;
+
+	const Board& board;
+	const MoveOrdering& ordering;
+	Move ttMove;
+	Move killers[2];
+	Move previousMove;
+	Stage stage = TT_MOVE;
+	int index = 0;
+
+	Movelist moves;
+	int captureCount = 0;
+	CaptureList badCaptures;
+};
+
+// Quiescence search variant that only ever generates captures
+class CapturePicker {
+public:
+	CapturePicker(const Board& board, const MoveOrdering& ordering, Move ttMove);
+
+	Move next();
+
+private:
+	enum Stage {
+		TT_MOVE,
+		GENERATE_CAPTURES,
+		CAPTURES,
+		DONE
+	};
+
+	const Board& board;
+	const MoveOrdering& ordering;
+	Move ttMove;
+	Stage stage = TT_MOVE;
+	int index = 0;
+
+	Movelist captures;
+	int captureCount = 0;
+};
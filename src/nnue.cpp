@@ -0,0 +1,230 @@
+#include "nnue.hpp"
+#include <algorithm>
+#include <cstring>
+#include <fstream>
+
+#if defined(__x86_64__) || defined(__i386__) || defined(_M_X64) || defined(_M_IX86)
+#define NNUE_X86 1
+#include <immintrin.h>
+#if defined(_MSC_VER) && !defined(__clang__)
+#include <intrin.h>
+// MSVC lets any intrinsic through, so no per-function target is needed
+#define NNUE_TARGET(isa)
+#else
+#define NNUE_TARGET(isa) __attribute__((target(isa)))
+#endif
+#endif
+
+NnueNetwork nnueNetwork;
+
+// Kernels over one NNUE_HIDDEN wide row. All rows are 64 byte aligned.
+
+static void addScalar(int16_t* accumulator, const int16_t* weights) {
+	for (int i = 0; i < NNUE_HIDDEN; i++) {
+		accumulator[i] += weights[i];
+	}
+}
+
+static void subScalar(int16_t* accumulator, const int16_t* weights) {
+	for (int i = 0; i < NNUE_HIDDEN; i++) {
+		accumulator[i] -= weights[i];
+	}
+}
+
+static int32_t dotScalar(const int16_t* accumulator, const int16_t* weights) {
+	int32_t sum = 0;
+	for (int i = 0; i < NNUE_HIDDEN; i++) {
+		int value = std::clamp<int>(accumulator[i], 0, NNUE_QA);
+		sum += value * weights[i];
+	}
+	return sum;
+}
+
+#ifdef NNUE_X86
+
+NNUE_TARGET("sse4.1") static void addSse41(int16_t* accumulator, const int16_t* weights) {
+	for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+		__m128i* a = reinterpret_cast<__m128i*>(accumulator + i);
+		__m128i w = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + i));
+		_mm_store_si128(a, _mm_add_epi16(_mm_load_si128(a), w));
+	}
+}
+
+NNUE_TARGET("sse4.1") static void subSse41(int16_t* accumulator, const int16_t* weights) {
+	for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+		__m128i* a = reinterpret_cast<__m128i*>(accumulator + i);
+		__m128i w = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + i));
+		_mm_store_si128(a, _mm_sub_epi16(_mm_load_si128(a), w));
+	}
+}
+
+NNUE_TARGET("sse4.1") static int32_t dotSse41(const int16_t* accumulator, const int16_t* weights) {
+	const __m128i zero = _mm_setzero_si128();
+	const __m128i ceiling = _mm_set1_epi16(NNUE_QA);
+	__m128i sum = _mm_setzero_si128();
+	for (int i = 0; i < NNUE_HIDDEN; i += 8) {
+		__m128i a = _mm_load_si128(reinterpret_cast<const __m128i*>(accumulator + i));
+		__m128i w = _mm_load_si128(reinterpret_cast<const __m128i*>(weights + i));
+		a = _mm_min_epi16(_mm_max_epi16(a, zero), ceiling);
+		sum = _mm_add_epi32(sum, _mm_madd_epi16(a, w));
+	}
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0x4E));
+	sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, 0xB1));
+	return _mm_cvtsi128_si32(sum);
+}
+
+NNUE_TARGET("avx2") static void addAvx2(int16_t* accumulator, const int16_t* weights) {
+	for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+		__m256i* a = reinterpret_cast<__m256i*>(accumulator + i);
+		__m256i w = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i));
+		_mm256_store_si256(a, _mm256_add_epi16(_mm256_load_si256(a), w));
+	}
+}
+
+NNUE_TARGET("avx2") static void subAvx2(int16_t* accumulator, const int16_t* weights) {
+	for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+		__m256i* a = reinterpret_cast<__m256i*>(accumulator + i);
+		__m256i w = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i));
+		_mm256_store_si256(a, _mm256_sub_epi16(_mm256_load_si256(a), w));
+	}
+}
+
+NNUE_TARGET("avx2") static int32_t dotAvx2(const int16_t* accumulator, const int16_t* weights) {
+	const __m256i zero = _mm256_setzero_si256();
+	const __m256i ceiling = _mm256_set1_epi16(NNUE_QA);
+	__m256i sum = _mm256_setzero_si256();
+	for (int i = 0; i < NNUE_HIDDEN; i += 16) {
+		__m256i a = _mm256_load_si256(reinterpret_cast<const __m256i*>(accumulator + i));
+		__m256i w = _mm256_load_si256(reinterpret_cast<const __m256i*>(weights + i));
+		a = _mm256_min_epi16(_mm256_max_epi16(a, zero), ceiling);
+		sum = _mm256_add_epi32(sum, _mm256_madd_epi16(a, w));
+	}
+	__m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0x4E));
+	half = _mm_add_epi32(half, _mm_shuffle_epi32(half, 0xB1));
+	return _mm_cvtsi128_si32(half);
+}
+
+#if defined(_MSC_VER) && !defined(__clang__)
+static bool cpuHasSse41() {
+	int info[4];
+	__cpuid(info, 1);
+	return info[2] & (1 << 19);
+}
+
+static bool cpuHasAvx2() {
+	int info[4];
+	__cpuid(info, 0);
+	if (info[0] < 7) {
+		return false;
+	}
+	// The OS also has to save the upper halves of the registers
+	__cpuid(info, 1);
+	bool osxsave = info[2] & (1 << 27);
+	bool avx = info[2] & (1 << 28);
+	if (!osxsave || !avx || (_xgetbv(0) & 6) != 6) {
+		return false;
+	}
+	__cpuidex(info, 7, 0);
+	return info[1] & (1 << 5);
+}
+#else
+static bool cpuHasSse41() {
+	return __builtin_cpu_supports("sse4.1");
+}
+
+static bool cpuHasAvx2() {
+	return __builtin_cpu_supports("avx2");
+}
+#endif
+
+#endif
+
+struct NnueKernels {
+	void (*add)(int16_t*, const int16_t*);
+	void (*sub)(int16_t*, const int16_t*);
+	int32_t (*dot)(const int16_t*, const int16_t*);
+	const char* name;
+};
+
+static NnueKernels selectKernels() {
+#ifdef NNUE_X86
+	if (cpuHasAvx2()) {
+		return {addAvx2, subAvx2, dotAvx2, "avx2"};
+	}
+	if (cpuHasSse41()) {
+		return {addSse41, subSse41, dotSse41, "sse4.1"};
+	}
+#endif
+	return {addScalar, subScalar, dotScalar, "scalar"};
+}
+
+static const NnueKernels kernels = selectKernels();
+
+static int featureIndex(Piece piece, Square sq, Color perspective) {
+	int side = piece.color() == perspective ? 0 : 6;
+	int square = perspective == Color::WHITE ? sq.index() : sq.index() ^ 56;
+	return (side + int(piece.type())) * 64 + square;
+}
+
+// The file is read straight into the arrays, which assumes a little endian host
+bool NnueNetwork::load(const std::string& path) {
+	isLoaded = false;
+
+	std::ifstream is(path, std::ios::binary);
+	if (is.fail()) {
+		return false;
+	}
+
+	char magic[4];
+	uint32_t hidden = 0;
+	is.read(magic, sizeof(magic));
+	is.read(reinterpret_cast<char*>(&hidden), sizeof(hidden));
+	if (!is || std::memcmp(magic, "CRNN", 4) != 0 || hidden != NNUE_HIDDEN) {
+		return false;
+	}
+
+	is.read(reinterpret_cast<char*>(featureWeights), sizeof(featureWeights));
+	is.read(reinterpret_cast<char*>(featureBias), sizeof(featureBias));
+	is.read(reinterpret_cast<char*>(outputWeights), sizeof(outputWeights));
+	is.read(reinterpret_cast<char*>(&outputBias), sizeof(outputBias));
+	if (!is || is.peek() != std::ifstream::traits_type::eof()) {
+		return false;
+	}
+
+	isLoaded = true;
+	return true;
+}
+
+void NnueNetwork::refresh(const Board& board, NnueAccumulator& accumulator) const {
+	std::copy(featureBias, featureBias + NNUE_HIDDEN, accumulator.values[0]);
+	std::copy(featureBias, featureBias + NNUE_HIDDEN, accumulator.values[1]);
+
+	Bitboard occupied = board.occ();
+	while (occupied) {
+		Square sq = occupied.pop();
+		addPiece(accumulator, board.at(sq), sq);
+	}
+}
+
+void NnueNetwork::addPiece(NnueAccumulator& accumulator, Piece piece, Square sq) const {
+	kernels.add(accumulator.values[0], featureWeights + featureIndex(piece, sq, Color::WHITE) * NNUE_HIDDEN);
+	kernels.add(accumulator.values[1], featureWeights + featureIndex(piece, sq, Color::BLACK) * NNUE_HIDDEN);
+}
+
+void NnueNetwork::removePiece(NnueAccumulator& accumulator, Piece piece, Square sq) const {
+	kernels.sub(accumulator.values[0], featureWeights + featureIndex(piece, sq, Color::WHITE) * NNUE_HIDDEN);
+	kernels.sub(accumulator.values[1], featureWeights + featureIndex(piece, sq, Color::BLACK) * NNUE_HIDDEN);
+}
+
+int NnueNetwork::evaluate(const NnueAccumulator& accumulator, Color sideToMove) const {
+	int us = sideToMove == Color::WHITE ? 0 : 1;
+	int64_t output = int64_t(kernels.dot(accumulator.values[us], outputWeights))
+		+ kernels.dot(accumulator.values[us ^ 1], outputWeights + NNUE_HIDDEN)
+		+ outputBias;
+	return int(output * NNUE_SCALE / (NNUE_QA * NNUE_QB));
+}
+
+const char* NnueNetwork::simdName() const {
+	return kernels.name;
+}
@@ -0,0 +1,63 @@
+#pragma once
+
+#include "chess.hpp"
+#include <cstdint>
+#include <string>
+
+using namespace chess;
+
+// Optional neural network evaluation. The network is a single hidden layer
+// over 768 piece-square inputs, evaluated from both sides' point of view:
+//
+//     (768 -> NNUE_HIDDEN) x 2 -> 1, clipped ReLU, int16 quantization
+//
+// The hidden layer ("accumulator") is the expensive part, and since a move
+// only toggles two to four inputs it's updated incrementally by SearchBoard.
+//
+// Weights file layout, little endian:
+//     char    magic[4]      "CRNN"
+//     uint32  hidden size   must equal NNUE_HIDDEN
+//     int16   featureWeights[768][NNUE_HIDDEN]
+//     int16   featureBias[NNUE_HIDDEN]
+//     int16   outputWeights[2][NNUE_HIDDEN]   side to move first
+//     int32   outputBias
+//
+// Feature weights and biases are scaled by NNUE_QA, output weights by
+// NNUE_QB and the output bias by NNUE_QA * NNUE_QB.
+
+const int NNUE_INPUTS = 768;
+const int NNUE_HIDDEN = 256;
+const int NNUE_QA = 255;
+const int NNUE_QB = 64;
+const int NNUE_SCALE = 400;
+
+struct alignas(64) NnueAccumulator {
+	int16_t values[2][NNUE_HIDDEN];
+};
+
+class NnueNetwork {
+public:
+	// Returns false and leaves the network unloaded if the file is missing
+	// or malformed
+	bool load(const std::string& path);
+	bool loaded() const { return isLoaded; }
+
+	void refresh(const Board& board, NnueAccumulator& accumulator) const;
+	void addPiece(NnueAccumulator& accumulator, Piece piece, Square sq) const;
+	void removePiece(NnueAccumulator& accumulator, Piece piece, Square sq) const;
+
+	// Centipawns from the side to move's point of view
+	int evaluate(const NnueAccumulator& accumulator, Color sideToMove) const;
+
+	// Instruction set picked at startup, for diagnostics
+	const char* simdName() const;
+
+private:
+	alignas(64) int16_t featureWeights[NNUE_INPUTS * NNUE_HIDDEN];
+	alignas(64) int16_t featureBias[NNUE_HIDDEN];
+	alignas(64) int16_t outputWeights[2 * NNUE_HIDDEN];
+	int32_t outputBias = 0;
+	bool isLoaded = false;
+};
+
+extern NnueNetwork nnueNetwork;
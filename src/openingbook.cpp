@@ -0,0 +1,219 @@
+#include "openingbook.hpp"
+#include <algorithm>
+#include <cctype>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+
+const size_t POLYGLOT_ENTRY_SIZE = 16;
+
+static uint64_t readBigEndian(const uint8_t* bytes, int length) {
+	uint64_t value = 0;
+	for (int i = 0; i < length; i++) {
+		value = value << 8 | bytes[i];
+	}
+	return value;
+}
+
+bool OpeningBook::load(const std::string& path) {
+	file.close();
+	parsed.clear();
+	format = BOOK_KEYS;
+	keys = nullptr;
+	count = 0;
+
+	if (!file.open(path)) {
+		return false;
+	}
+	OpeningBookHeader header;
+	if (file.size() < sizeof(header) || std::memcmp(file.data(), "CRBK", 4) != 0) {
+		// Polyglot has no header, but its first entry is binary where a
+		// text book would be all FEN characters
+		bool binary = false;
+		for (size_t i = 0; i < std::min<size_t>(file.size(), POLYGLOT_ENTRY_SIZE); i++) {
+			binary |= !std::isprint(file.data()[i]) && !std::isspace(file.data()[i]);
+		}
+		if (!binary) {
+			file.close();
+			return loadText(path);
+		}
+		if (file.size() % POLYGLOT_ENTRY_SIZE != 0) {
+			file.close();
+			return false;
+		}
+		format = BOOK_POLYGLOT;
+		count = file.size() / POLYGLOT_ENTRY_SIZE;
+		return true;
+	}
+
+	std::memcpy(&header, file.data(), sizeof(header));
+	if (header.version != OPENING_BOOK_VERSION || file.size() != sizeof(header) + header.count * sizeof(uint64_t)) {
+		file.close();
+		return false;
+	}
+	keys = reinterpret_cast<const uint64_t*>(file.data() + sizeof(header));
+	count = header.count;
+	return true;
+}
+
+bool OpeningBook::loadDefault() {
+	return load("opening_book.bin") || load(OPENING_BOOK_BIN) || load("opening_book.txt");
+}
+
+// A FEN may name an en passant square no pawn can capture on, which the
+// board keeps but never sets itself after a double push
+static uint64_t positionKey(const std::string& fen) {
+	Board board(fen);
+	Square ep = board.enpassantSq();
+	if (ep != Square::underlying::NO_SQ &&
+		!(attacks::pawn(~board.sideToMove(), ep) & board.pieces(PieceType::PAWN, board.sideToMove()))) {
+		std::istringstream fields(fen);
+		std::string placement, side, castling;
+		fields >> placement >> side >> castling;
+		board.setFen(placement + " " + side + " " + castling + " -");
+	}
+	return board.hash();
+}
+
+bool OpeningBook::loadText(const std::string& path) {
+	std::ifstream is(path);
+	if (is.fail()) {
+		return false;
+	}
+	std::string fen;
+	while (std::getline(is, fen)) {
+		if (!fen.empty() && fen.back() == '\r') {
+			fen.pop_back();
+		}
+		if (!fen.empty()) {
+			parsed.push_back(positionKey(fen));
+		}
+	}
+	std::sort(parsed.begin(), parsed.end());
+	parsed.erase(std::unique(parsed.begin(), parsed.end()), parsed.end());
+	keys = parsed.data();
+	count = parsed.size();
+	return true;
+}
+
+bool OpeningBook::save(const std::string& path) const {
+	// A Polyglot book repeats the key for every move, and is already sorted
+	std::vector<uint64_t> polyglotKeys;
+	if (format == BOOK_POLYGLOT) {
+		for (size_t i = 0; i < count; i++) {
+			uint64_t key = polyglotKey(i);
+			if (polyglotKeys.empty() || polyglotKeys.back() != key) {
+				polyglotKeys.push_back(key);
+			}
+		}
+	}
+	const uint64_t* saved = format == BOOK_POLYGLOT ? polyglotKeys.data() : keys;
+	size_t savedCount = format == BOOK_POLYGLOT ? polyglotKeys.size() : count;
+
+	std::ofstream os(path, std::ios::binary);
+	if (!os) {
+		return false;
+	}
+	OpeningBookHeader header;
+	std::memcpy(header.magic, "CRBK", 4);
+	header.version = OPENING_BOOK_VERSION;
+	header.count = savedCount;
+	os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	os.write(reinterpret_cast<const char*>(saved), savedCount * sizeof(uint64_t));
+	return bool(os);
+}
+
+uint64_t OpeningBook::polyglotKey(size_t entry) const {
+	return readBigEndian(file.data() + entry * POLYGLOT_ENTRY_SIZE, 8);
+}
+
+uint16_t OpeningBook::polyglotMove(size_t entry) const {
+	return uint16_t(readBigEndian(file.data() + entry * POLYGLOT_ENTRY_SIZE + 8, 2));
+}
+
+// First entry with a key not below `key`. Interpolation narrows the range
+// like contains() does, keeping the keys at its ends from earlier guesses,
+// then bisection finds the first of the position's entries.
+size_t OpeningBook::polyglotLowerBound(uint64_t key) const {
+	if (count == 0 || key <= polyglotKey(0)) {
+		return 0;
+	}
+	if (key > polyglotKey(count - 1)) {
+		return count;
+	}
+	// The entry sought is after low and no later than high
+	size_t low = 0;
+	size_t high = count - 1;
+	uint64_t lowKey = polyglotKey(low);
+	uint64_t highKey = polyglotKey(high);
+	while (high - low > 8) {
+		double fraction = double(key - lowKey) / double(highKey - lowKey);
+		size_t guess = std::min(high - 1, low + 1 + size_t(fraction * double(high - low - 1)));
+		uint64_t guessKey = polyglotKey(guess);
+		if (guessKey < key) {
+			low = guess;
+			lowKey = guessKey;
+		}
+		else {
+			high = guess;
+			highKey = guessKey;
+		}
+	}
+	low++;
+	while (low < high) {
+		size_t middle = low + (high - low) / 2;
+		if (polyglotKey(middle) < key) {
+			low = middle + 1;
+		}
+		else {
+			high = middle;
+		}
+	}
+	return low;
+}
+
+bool OpeningBook::contains(uint64_t key) const {
+	if (count == 0) {
+		return false;
+	}
+	if (format == BOOK_POLYGLOT) {
+		size_t entry = polyglotLowerBound(key);
+		return entry < count && polyglotKey(entry) == key;
+	}
+	size_t low = 0;
+	size_t high = count - 1;
+	while (key >= keys[low] && key <= keys[high]) {
+		if (keys[low] == keys[high]) {
+			return true;
+		}
+		double fraction = double(key - keys[low]) / double(keys[high] - keys[low]);
+		size_t guess = low + size_t(fraction * double(high - low));
+		if (keys[guess] == key) {
+			return true;
+		}
+		if (keys[guess] < key) {
+			low = guess + 1;
+		}
+		else {
+			high = guess - 1;
+		}
+	}
+	return false;
+}
+
+// Polyglot moves are laid out like ours in the low 12 bits, from and to
+// square, castling included as the king taking its rook. Bits 12-14 are the
+// promotion piece, knight 1 to queen 4.
+bool OpeningBook::hasMove(uint64_t key, Move move) const {
+	if (format != BOOK_POLYGLOT) {
+		return false;
+	}
+	int promotion = move.typeOf() == Move::PROMOTION ? int(move.promotionType()) : 0;
+	uint16_t wanted = uint16_t(promotion << 12 | (move.move() & 0xFFF));
+	for (size_t entry = polyglotLowerBound(key); entry < count && polyglotKey(entry) == key; entry++) {
+		if (polyglotMove(entry) == wanted) {
+			return true;
+		}
+	}
+	return false;
+}
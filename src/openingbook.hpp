@@ -0,0 +1,75 @@
+#pragma once
+
+#include "chess.hpp"
+#include "mappedfile.hpp"
+#include <cstdint>
+#include <string>
+#include <vector>
+
+using namespace chess;
+
+// Opening positions looked up by Board::hash(), from one of three formats:
+//
+// - Our own binary book, a 16-byte header followed by the sorted keys.
+//   Zobrist keys are spread evenly, so a lookup interpolates straight to the
+//   neighbourhood of the key instead of bisecting the whole array.
+//   chessreview-bookgen writes it from a text book.
+// - A Polyglot book: 16-byte big-endian entries of key, move, weight and
+//   learn data, sorted by key, one per book move. The library's Zobrist
+//   table and en passant rule are Polyglot's, so Board::hash() is the
+//   Polyglot key. Lookups bisect the entries, since a position's moves share
+//   a key.
+// - A text book of FENs, one per line, parsed into keys on load.
+//
+// The binary formats are memory-mapped, so opening one takes the same time
+// and memory whatever the size of the book.
+
+struct OpeningBookHeader {
+	char magic[4];
+	uint32_t version;
+	uint64_t count;
+};
+
+const uint32_t OPENING_BOOK_VERSION = 1;
+
+// Where the build writes the binary book it converts from opening_book.txt
+#ifndef OPENING_BOOK_BIN
+#define OPENING_BOOK_BIN "opening_book.bin"
+#endif
+
+class OpeningBook {
+public:
+	// Any of the formats, told apart by their contents. False if the file is
+	// missing or malformed.
+	bool load(const std::string& path);
+	// The first that loads of opening_book.bin in the working directory, the
+	// book the build generated and opening_book.txt
+	bool loadDefault();
+	// Writes the keys in our own format
+	bool save(const std::string& path) const;
+
+	bool contains(uint64_t key) const;
+	// Whether the book plays `move` from the position. Only Polyglot books
+	// have moves.
+	bool hasMove(uint64_t key, Move move) const;
+	// Positions, or for a Polyglot book entries
+	size_t size() const { return count; }
+
+private:
+	enum BookFormat : uint8_t {
+		BOOK_KEYS,
+		BOOK_POLYGLOT
+	};
+
+	bool loadText(const std::string& path);
+	uint64_t polyglotKey(size_t entry) const;
+	uint16_t polyglotMove(size_t entry) const;
+	size_t polyglotLowerBound(uint64_t key) const;
+
+	MappedFile file;
+	BookFormat format = BOOK_KEYS;
+	// Keys of a text book, which has nothing to map
+	std::vector<uint64_t> parsed;
+	const uint64_t* keys = nullptr;
+	size_t count = 0;
+};
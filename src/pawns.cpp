@@ -0,0 +1,154 @@
+#include "pawns.hpp"
+#include "searchboard.hpp"
+#include <array>
+
+const int DOUBLED_MG = -10;
+const int DOUBLED_EG = -20;
+const int ISOLATED_MG = -10;
+const int ISOLATED_EG = -15;
+const int BACKWARD_MG = -8;
+const int BACKWARD_EG = -10;
+// By relative rank
+constexpr int PASSED_MG[8] = {0, 5, 10, 15, 30, 50, 80, 0};
+constexpr int PASSED_EG[8] = {0, 10, 20, 35, 60, 100, 150, 0};
+
+// Shelter for a king, per file next to it: a pawn on the second rank, a pawn
+// on the third rank, or nothing in front of the king at all
+const int SHELTER_ADVANCED = -10;
+const int SHELTER_MISSING = -25;
+
+const uint64_t FILE_A = 0x0101010101010101ULL;
+const uint64_t FILE_H = FILE_A << 7;
+
+constexpr uint64_t fileMask(int file) {
+	return FILE_A << file;
+}
+
+constexpr uint64_t adjacentFilesMask(int file) {
+	return (file > 0 ? fileMask(file - 1) : 0) | (file < 7 ? fileMask(file + 1) : 0);
+}
+
+// Ranks strictly in front of a square from a side's point of view
+constexpr uint64_t forwardRanksMask(int side, int sq) {
+	int rank = sq / 8;
+	if (side == 0) {
+		return rank == 7 ? 0 : ~0ULL << (8 * (rank + 1));
+	}
+	return (1ULL << (8 * rank)) - 1;
+}
+
+using SquareMasks = std::array<std::array<uint64_t, 64>, 2>;
+
+// Squares ahead on the same file, and the squares an enemy pawn would need
+// to stop a pawn from being passed
+constexpr SquareMasks FORWARD_FILE = [] {
+	SquareMasks masks = {};
+	for (int side = 0; side < 2; side++) {
+		for (int sq = 0; sq < 64; sq++) {
+			masks[side][sq] = forwardRanksMask(side, sq) & fileMask(sq % 8);
+		}
+	}
+	return masks;
+}();
+
+constexpr SquareMasks PASSED_SPAN = [] {
+	SquareMasks masks = {};
+	for (int side = 0; side < 2; side++) {
+		for (int sq = 0; sq < 64; sq++) {
+			masks[side][sq] = forwardRanksMask(side, sq) & (fileMask(sq % 8) | adjacentFilesMask(sq % 8));
+		}
+	}
+	return masks;
+}();
+
+static uint64_t pawnAttacks(int side, uint64_t pawns) {
+	if (side == 0) {
+		return ((pawns & ~FILE_A) << 7) | ((pawns & ~FILE_H) << 9);
+	}
+	return ((pawns & ~FILE_A) >> 9) | ((pawns & ~FILE_H) >> 7);
+}
+
+static void evaluateSide(int side, uint64_t own, uint64_t enemy, int& midgame, int& endgame) {
+	uint64_t enemyAttacks = pawnAttacks(side ^ 1, enemy);
+
+	Bitboard pawns(own);
+	while (pawns) {
+		int sq = pawns.pop();
+
+		int file = sq % 8;
+		int relativeRank = side == 0 ? sq / 8 : 7 - sq / 8;
+		uint64_t neighbours = own & adjacentFilesMask(file);
+
+		if (own & FORWARD_FILE[side][sq]) {
+			midgame += DOUBLED_MG;
+			endgame += DOUBLED_EG;
+		}
+		else if (!(enemy & PASSED_SPAN[side][sq])) {
+			midgame += PASSED_MG[relativeRank];
+			endgame += PASSED_EG[relativeRank];
+		}
+
+		if (!neighbours) {
+			midgame += ISOLATED_MG;
+			endgame += ISOLATED_EG;
+		}
+		else if (!(neighbours & ~forwardRanksMask(side, sq))) {
+			// Every neighbour is ahead, so none can come up to support it,
+			// and advancing walks into an enemy pawn's capture
+			uint64_t stop = side == 0 ? 1ULL << (sq + 8) : 1ULL << (sq - 8);
+			if (stop & enemyAttacks) {
+				midgame += BACKWARD_MG;
+				endgame += BACKWARD_EG;
+			}
+		}
+	}
+}
+
+static int shelterFor(int side, uint64_t own, int kingFile) {
+	int score = 0;
+	uint64_t secondRank = side == 0 ? 0xFFULL << 8 : 0xFFULL << 48;
+	uint64_t thirdRank = side == 0 ? 0xFFULL << 16 : 0xFFULL << 40;
+	int first = kingFile > 0 ? kingFile - 1 : 0;
+	int last = kingFile < 7 ? kingFile + 1 : 7;
+	for (int file = first; file <= last; file++) {
+		uint64_t shield = own & fileMask(file);
+		if (shield & secondRank) {
+			continue;
+		}
+		score += (shield & thirdRank) ? SHELTER_ADVANCED : SHELTER_MISSING;
+	}
+	return score;
+}
+
+PawnTable::PawnTable() : entries(new PawnEntry[PAWN_TABLE_ENTRIES]) {
+	// Give every slot a key that can't map to it, so nothing hits before
+	// the slot has been written
+	for (size_t i = 0; i < PAWN_TABLE_ENTRIES; i++) {
+		entries[i].key = ~uint64_t(i);
+	}
+}
+
+const PawnEntry& PawnTable::probe(const SearchBoard& board) {
+	uint64_t key = board.pawnKey();
+	PawnEntry& entry = entries[key & (PAWN_TABLE_ENTRIES - 1)];
+	if (entry.key == key) {
+		return entry;
+	}
+
+	uint64_t white = board.pieces(PieceType::PAWN, Color::WHITE).getBits();
+	uint64_t black = board.pieces(PieceType::PAWN, Color::BLACK).getBits();
+
+	int whiteMidgame = 0, whiteEndgame = 0;
+	int blackMidgame = 0, blackEndgame = 0;
+	evaluateSide(0, white, black, whiteMidgame, whiteEndgame);
+	evaluateSide(1, black, white, blackMidgame, blackEndgame);
+
+	entry.key = key;
+	entry.midgame = int16_t(whiteMidgame - blackMidgame);
+	entry.endgame = int16_t(whiteEndgame - blackEndgame);
+	for (int file = 0; file < 8; file++) {
+		entry.shelter[0][file] = int16_t(shelterFor(0, white, file));
+		entry.shelter[1][file] = int16_t(shelterFor(1, black, file));
+	}
+	return entry;
+}
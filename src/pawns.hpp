@@ -0,0 +1,32 @@
+#pragma once
+
+#include "chess.hpp"
+#include <cstdint>
+#include <memory>
+
+using namespace chess;
+
+class SearchBoard;
+
+const size_t PAWN_TABLE_ENTRIES = 1 << 14;
+
+// Pawn structure terms for one pawn configuration, white relative
+struct PawnEntry {
+	uint64_t key = 0;
+	int16_t midgame = 0;
+	int16_t endgame = 0;
+	// Midgame shelter score of each side's pawns for a king on each file
+	int16_t shelter[2][8] = {};
+};
+
+// Per-thread cache of pawn structure evaluation keyed by the pawn hash. Pawn
+// moves are rare compared to other moves, so nearly every probe hits.
+class PawnTable {
+public:
+	PawnTable();
+
+	const PawnEntry& probe(const SearchBoard& board);
+
+private:
+	std::unique_ptr<PawnEntry[]> entries;
+};
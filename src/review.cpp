@@ -0,0 +1,520 @@
+#include "review.hpp"
+#include "analysiscache.hpp"
+#include "see.hpp"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <memory>
+#include <mutex>
+#include <thread>
+
+// Depth a cached result needs to stand in for a search under `limits`. A
+// search with a time or node limit has no depth to match, so it takes one
+// about as deep as a short timed search reaches.
+static int minCacheDepth(const SearchLimits& limits) {
+	if (limits.milliseconds > 0 || limits.nodes > 0) {
+		return std::min(limits.maxDepth, REVIEW_CACHE_DEPTH);
+	}
+	return limits.maxDepth;
+}
+
+// A forced mate the search saw all of doesn't change with more depth
+static bool deepEnough(int depth, int score, int minDepth) {
+	return depth >= minDepth || (std::abs(score) >= MATE_BOUND && MATE_SCORE - std::abs(score) <= depth);
+}
+
+// A cached entry for the position stands in for a search to `minDepth` if it
+// has a best move and the played move's score is known too, either from the
+// same entry or from the position the move leads to, one ply shallower
+static bool probeCache(const Board& position, Move played, int minDepth, SearchResult& result) {
+	int depth, score;
+	Move bestMove;
+	if (!analysisCache.probe(position.hash(), depth, score, bestMove) || bestMove == Move::NO_MOVE ||
+		!deepEnough(depth, score, minDepth)) {
+		return false;
+	}
+	result.bestMove = bestMove;
+	result.score = score;
+	result.depth = depth;
+	result.nodes = 0;
+	if (played == bestMove) {
+		result.scoredMoveScore = score;
+		return true;
+	}
+
+	Board child = position;
+	child.makeMove(played);
+	int childDepth, childScore;
+	Move childMove;
+	if (!analysisCache.probe(child.hash(), childDepth, childScore, childMove)) {
+		return false;
+	}
+	// Mate distances are stored from the cached position
+	int scoredMoveScore = -scoreFromTT(childScore, 1);
+	if (!deepEnough(childDepth + 1, scoredMoveScore, minDepth)) {
+		return false;
+	}
+	result.scoredMoveScore = scoredMoveScore;
+	return true;
+}
+
+static void storeCache(const Board& position, Move played, const SearchResult& result) {
+	if (result.bestMove == Move::NO_MOVE) {
+		return;
+	}
+	analysisCache.store(position.hash(), result.depth, result.score, result.bestMove);
+
+	Board child = position;
+	child.makeMove(played);
+	analysisCache.store(child.hash(), result.depth - 1, scoreToTT(-result.scoredMoveScore, 1), Move::NO_MOVE);
+}
+
+using PlySearch = std::function<SearchResult(size_t ply, ThreadData& td, const SearchSeed& seed)>;
+
+// Consecutive plies of a game are a position and its child, so the search of
+// one can warm start the next. Plies from different games, or not next to
+// each other, don't match up.
+static bool seedFrom(const Board& parent, Move played, const SearchResult& previous, const Board& position, SearchSeed& seed) {
+	Board child = parent;
+	child.makeMove(played);
+	if (child.hash() != position.hash() || previous.depth == 0) {
+		return false;
+	}
+	if (previous.bestMove == played) {
+		seed.move = previous.expectedReply;
+	}
+	return true;
+}
+
+// Workers take the next unsearched ply until none are left. Results that
+// aren't worth keeping, like those of a shallow pass, can be left out of the
+// cache.
+static std::vector<SearchResult> analyzePlies(const std::vector<Board>& positions, const std::vector<Move>& played,
+	const PlySearch& searchPly, const std::function<int(size_t ply)>& minDepth, int threads, const PlyCallback& onPly, const std::atomic<bool>* cancel,
+	bool storeResults = true) {
+	std::vector<SearchResult> results(positions.size());
+	if (positions.empty()) {
+		return results;
+	}
+	if (threads <= 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	threads = std::min<int>(threads, positions.size());
+
+	transpositionTable.newSearch();
+
+	// Set once a ply's result may be read by the worker on the next ply
+	std::vector<std::atomic<bool>> finished(positions.size());
+	std::atomic<size_t> next{0};
+	auto worker = [&] {
+		auto td = std::make_unique<ThreadData>();
+		size_t lastSearched = SIZE_MAX;
+		size_t ply;
+		while ((ply = next.fetch_add(1)) < positions.size()) {
+			if (cancel && cancel->load()) {
+				break;
+			}
+			if (!probeCache(positions[ply], played[ply], minDepth(ply), results[ply])) {
+				SearchSeed seed;
+				if (ply > 0 && finished[ply - 1].load(std::memory_order_acquire) &&
+					seedFrom(positions[ply - 1], played[ply - 1], results[ply - 1], positions[ply], seed)) {
+					seed.followsLastSearch = lastSearched == ply - 1;
+				}
+				results[ply] = searchPly(ply, *td, seed);
+				lastSearched = ply;
+				if (storeResults) {
+					storeCache(positions[ply], played[ply], results[ply]);
+				}
+			}
+			finished[ply].store(true, std::memory_order_release);
+			if (onPly) {
+				onPly(ply, results[ply]);
+			}
+		}
+	};
+
+	std::vector<std::thread> workers;
+	for (int i = 1; i < threads; i++) {
+		workers.emplace_back(worker);
+	}
+	worker();
+	for (auto& thread : workers) {
+		thread.join();
+	}
+	return results;
+}
+
+std::vector<SearchResult> analyzeGame(const std::vector<Board>& positions, const std::vector<Move>& played,
+	const SearchLimits& limits, int threads, const PlyCallback& onPly, const std::atomic<bool>* cancel) {
+	return analyzePlies(positions, played, [&](size_t ply, ThreadData& td, const SearchSeed& seed) {
+		return searchPosition(positions[ply], td, limits, played[ply], seed);
+	}, [&](size_t) { return minCacheDepth(limits); }, threads, onPly, cancel);
+}
+
+std::vector<SearchResult> analyzeGame(const std::vector<Board>& positions, const std::vector<Move>& played,
+	ReviewScheduler& scheduler, int threads, const PlyCallback& onPly, const std::atomic<bool>* cancel) {
+	return analyzePlies(positions, played, [&](size_t ply, ThreadData& td, const SearchSeed& seed) {
+		return scheduler.search(ply, td, seed);
+	}, [&](size_t ply) { return scheduler.cacheDepth(ply); }, threads, onPly, cancel);
+}
+
+static bool isMiss(const GameRecord& game, size_t moveIndex, Color player) {
+	if(moveIndex < 2) {
+		return false;
+	}
+
+	int eval = game.evaluation(moveIndex, player);
+	int pEval = game.evaluation(moveIndex - 1, player);
+	int ppEval = game.evaluation(moveIndex - 2, player);
+
+	if(pEval - ppEval >= MISTAKE_THRESHOLD && (pEval - eval >= MISTAKE_THRESHOLD && eval >= ppEval)) {
+		return true;
+	}
+
+	return false;
+}
+
+static bool isMistake(const GameRecord& game, size_t moveIndex, Color player) {
+	if(moveIndex < 1) {
+		return false;
+	}
+
+	int pEval = game.evaluation(moveIndex - 1, player);
+	int eval = game.evaluation(moveIndex, player);
+
+	if (pEval - eval >= MISTAKE_THRESHOLD && pEval - eval < BLUNDER_THRESHOLD) {
+		return true;
+	}
+	return false;
+}
+
+static bool isBlunder(const GameRecord& game, size_t moveIndex, Color player) {
+	if(moveIndex < 1) {
+		return false;
+	}
+
+	int pEval = game.evaluation(moveIndex - 1, player);
+	int eval = game.evaluation(moveIndex, player);
+
+	if (pEval - eval >= BLUNDER_THRESHOLD) {
+		return true;
+	}
+	return false;
+}
+
+// A move is brilliant when it gives up material in the exchange on its
+// target square and the evaluation still holds
+static bool isBrilliant(const Board& board, const GameRecord& game, size_t moveIndex, Color player) {
+	if(moveIndex < 1) {
+		return false;
+	}
+
+	int pEval = game.evaluation(moveIndex - 1, player);
+	int eval = game.evaluation(moveIndex, player);
+
+	if(staticExchange(board, game.moves[moveIndex]) < 0 && pEval - eval < MISTAKE_THRESHOLD) {
+		return true;
+	}
+	return false;
+}
+
+// A book move's evaluation only matters as the baseline of the two moves
+// after it, so a book move followed by two more isn't searched at all
+static bool skipsSearch(const std::vector<bool>& inBook, size_t ply) {
+	bool baseline = (ply + 1 < inBook.size() && !inBook[ply + 1]) || (ply + 2 < inBook.size() && !inBook[ply + 2]);
+	return inBook[ply] && !baseline;
+}
+
+void recordResult(GameRecord& game, size_t ply, const SearchResult& result) {
+	PlyAnalysis& analysis = game.analysis[ply];
+	analysis.bestMove = result.bestMove;
+	// The played move's score is from the mover's side
+	analysis.evaluation = game.sideToMove(ply) == Color::WHITE ? result.scoredMoveScore : -result.scoredMoveScore;
+}
+
+Classification classifyMove(const GameRecord& game, const Board& board, size_t moveIndex, Color player) {
+	if(game.sideToMove(moveIndex) != player) {
+		return None;
+	}
+	if(game.inBook(moveIndex)) {
+		return Book;
+	}else if(isMiss(game, moveIndex, player)) {
+		return Miss;
+	}else if(isMistake(game, moveIndex, player)) {
+		return Mistake;
+	}else if(isBlunder(game, moveIndex, player)) {
+		return Blunder;
+	}else if(isBrilliant(board, game, moveIndex, player)) {
+		return Brilliant;
+	}
+	return Good;
+}
+
+// Plies of the sweep worth searching again: both ends of every drop of the
+// reviewed player that lies close to the mistake or blunder line. Lopsided
+// positions are refined too, since a shallow search is often wrong about
+// them, but not a mate the sweep already found. Plies the cache had deeper
+// results for are left alone.
+static std::vector<size_t> borderlinePlies(const std::vector<SearchResult>& results, const GameRecord& game, Color player) {
+	std::vector<bool> refine(results.size(), false);
+	auto check = [&](size_t before, size_t after) {
+		int pEval = game.evaluation(before, player);
+		int eval = game.evaluation(after, player);
+		if (std::abs(pEval) >= MATE_BOUND && std::abs(eval) >= MATE_BOUND && (pEval > 0) == (eval > 0)) {
+			return;
+		}
+		int drop = pEval - eval;
+		int margin = REVIEW_SWEEP_MARGIN + results[before].swing + results[after].swing;
+		if (std::abs(drop - MISTAKE_THRESHOLD) < margin || std::abs(drop - BLUNDER_THRESHOLD) < margin) {
+			refine[before] = true;
+			refine[after] = true;
+		}
+	};
+	for (size_t i = 1; i < results.size(); i++) {
+		if (game.sideToMove(i) != player) {
+			continue;
+		}
+		check(i - 1, i);
+		// A miss also looks at the opponent's move before
+		if (i >= 2) {
+			check(i - 2, i - 1);
+		}
+	}
+
+	std::vector<size_t> plies;
+	for (size_t i = 0; i < results.size(); i++) {
+		if (refine[i] && results[i].depth <= REVIEW_SWEEP_DEPTH) {
+			plies.push_back(i);
+		}
+	}
+	return plies;
+}
+
+// A ply is published once it and all the plies before it are searched,
+// because its classification compares against the earlier evaluations. The
+// refinement starts from the transposition table the sweep filled, so its
+// first iterations are nearly free and the sweep's best moves lead the root.
+void reviewGame(GameRecord& game, Color player, const SearchLimits& limits, int64_t milliseconds, int threads,
+	PlyChannel<PlyAnalysis>& channel, const std::atomic<bool>& cancel) {
+	auto start = std::chrono::steady_clock::now();
+	// Every position is known up front, so the plies can be searched in parallel
+	std::vector<Board> positions = game.positions();
+	const std::vector<Move>& played = game.moves;
+	size_t plies = game.size();
+
+	std::vector<bool> inBook(plies);
+	for(size_t ply = 0; ply < plies; ply++) {
+		inBook[ply] = game.inBook(ply);
+	}
+
+	std::vector<SearchResult> results(plies);
+	std::vector<bool> searched(plies, false);
+	std::vector<bool> refining(plies, false);
+	bool sweeping = true;
+	size_t nextToPublish = 0;
+	std::mutex mutex;
+
+	// Both run with the mutex held
+	auto record = [&](size_t ply, const SearchResult& result) {
+		results[ply] = result;
+		recordResult(game, ply, result);
+	};
+	// A classification depends on the two evaluations before it as well
+	auto publish = [&](size_t ply) {
+		PlyAnalysis& analysis = game.analysis[ply];
+		analysis.cl = classifyMove(game, positions[ply], ply, player);
+		bool provisional = sweeping || refining[ply] || (ply >= 1 && refining[ply - 1]) || (ply >= 2 && refining[ply - 2]);
+		if(provisional) {
+			analysis.flags |= ANALYSIS_PROVISIONAL;
+		}else{
+			analysis.flags &= ~ANALYSIS_PROVISIONAL;
+		}
+		channel.publish(ply, analysis);
+	};
+
+	SearchLimits sweepLimits = limits;
+	sweepLimits.maxDepth = std::min(limits.maxDepth, REVIEW_SWEEP_DEPTH);
+	sweepLimits.milliseconds = 0;
+	analyzePlies(positions, played, [&](size_t ply, ThreadData& td, const SearchSeed& seed) {
+		// Classified from the book alone, and the played move stands as best
+		if(skipsSearch(inBook, ply)) {
+			SearchResult result;
+			result.bestMove = played[ply];
+			return result;
+		}
+		return searchPosition(positions[ply], td, sweepLimits, played[ply], seed);
+	}, [&](size_t) { return minCacheDepth(sweepLimits); }, threads, [&](size_t ply, const SearchResult& result) {
+		std::lock_guard<std::mutex> lock(mutex);
+		record(ply, result);
+		searched[ply] = true;
+		while(nextToPublish < plies && searched[nextToPublish]) {
+			publish(nextToPublish);
+			nextToPublish++;
+		}
+	}, &cancel, false);
+	if(cancel) {
+		return;
+	}
+
+	std::vector<size_t> borderline = borderlinePlies(results, game, player);
+	std::vector<Board> refinePositions;
+	std::vector<Move> refinePlayed;
+	std::vector<bool> refineInBook;
+	std::vector<int> refineDepths;
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		sweeping = false;
+		for(size_t ply : borderline) {
+			refining[ply] = true;
+			refinePositions.push_back(positions[ply]);
+			refinePlayed.push_back(played[ply]);
+			refineInBook.push_back(inBook[ply]);
+			refineDepths.push_back(results[ply].depth);
+		}
+		for(size_t ply = 0; ply < plies; ply++) {
+			publish(ply);
+		}
+	}
+	if(borderline.empty()) {
+		return;
+	}
+
+	int64_t elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+	ReviewScheduler scheduler(refinePositions, refinePlayed, refineInBook, limits, std::max<int64_t>(1, milliseconds - elapsed), threads,
+		refineDepths);
+	analyzeGame(refinePositions, refinePlayed, scheduler, threads, [&](size_t index, const SearchResult& result) {
+		std::lock_guard<std::mutex> lock(mutex);
+		size_t ply = borderline[index];
+		// Plies the scheduler passes over keep their sweep result
+		if(result.depth >= results[ply].depth) {
+			record(ply, result);
+		}
+		refining[ply] = false;
+		for(size_t later = ply; later < std::min(ply + 3, plies); later++) {
+			publish(later);
+		}
+	}, &cancel);
+}
+
+const char* classificationName(Classification cl) {
+	switch (cl) {
+		case Book: return "book";
+		case Good: return "good";
+		case Miss: return "miss";
+		case Mistake: return "mistake";
+		case Blunder: return "blunder";
+		case Brilliant: return "brilliant";
+		default: return "none";
+	}
+}
+
+ReviewScheduler::ReviewScheduler(const std::vector<Board>& positions, const std::vector<Move>& played,
+	const std::vector<bool>& inBook, const SearchLimits& limits, int64_t milliseconds, int threads,
+	const std::vector<int>& searchedDepths)
+	: positions(positions), played(played), limits(limits), kinds(positions.size(), PLY_NORMAL),
+	minDepths(positions.size()) {
+	// The plies' searches are all timed
+	SearchLimits timed = limits;
+	timed.milliseconds = std::max<int64_t>(1, limits.milliseconds);
+	int normal = 0;
+	for (size_t i = 0; i < positions.size(); i++) {
+		minDepths[i] = minCacheDepth(timed);
+		if (i < searchedDepths.size()) {
+			minDepths[i] = std::max(minDepths[i], searchedDepths[i] + 1);
+		}
+		Movelist moves;
+		movegen::legalmoves(moves, positions[i]);
+		SearchResult cached;
+		if (skipsSearch(inBook, i) || probeCache(positions[i], played[i], minDepths[i], cached)) {
+			kinds[i] = PLY_SKIP;
+		}
+		else if (inBook[i] || moves.size() == 1) {
+			kinds[i] = PLY_FORCED;
+		}
+		else {
+			normal++;
+		}
+	}
+
+	if (threads <= 0) {
+		threads = std::max(1u, std::thread::hardware_concurrency());
+	}
+	// Searches run side by side, so the budget is in thread time
+	int64_t total = milliseconds * std::min<int64_t>(threads, std::max<size_t>(1, positions.size()));
+	share = std::max<int64_t>(1, total * SCHEDULE_BASE_PERCENT / 100 / std::max(1, normal));
+	reserve = total - share * normal;
+	unfinished = normal;
+}
+
+SearchResult ReviewScheduler::search(size_t ply, ThreadData& td, const SearchSeed& seed) {
+	const Board& position = positions[ply];
+	Move move = played[ply];
+	SearchResult result;
+	if (kinds[ply] == PLY_SKIP) {
+		result.bestMove = move;
+		return result;
+	}
+
+	SearchLimits plyLimits = limits;
+	if (kinds[ply] == PLY_FORCED) {
+		plyLimits.maxDepth = std::min(limits.maxDepth, SCHEDULE_FORCED_DEPTH);
+		plyLimits.milliseconds = std::max<int64_t>(1, share / 8);
+		return searchPosition(position, td, plyLimits, move, seed);
+	}
+
+	int64_t allotted = share;
+	int previousDrop = 0;
+	for (int extension = 0; ; extension++) {
+		plyLimits.milliseconds = allotted;
+		auto start = std::chrono::steady_clock::now();
+		SearchResult next = searchPosition(position, td, plyLimits, move, extension == 0 ? seed : SearchSeed());
+		int64_t used = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start).count();
+		if (next.depth >= result.depth) {
+			result = next;
+		}
+		// Hand back what a search that ran out of depth didn't use
+		if (used < allotted) {
+			reserve += allotted - used;
+		}
+
+		int drop = result.score - result.scoredMoveScore;
+		bool unstable = extension > 0 && std::abs(drop - previousDrop) >= SCHEDULE_MARGIN / 2;
+		previousDrop = drop;
+		if (extension >= SCHEDULE_MAX_EXTENSIONS || result.depth >= limits.maxDepth ||
+			(!nearThreshold(result) && !unstable)) {
+			break;
+		}
+		allotted = claimReserve(share << (extension + 1));
+		// A limit of 0 would mean no limit at all
+		if (allotted == 0 || allotted < share / 4) {
+			break;
+		}
+	}
+	unfinished--;
+	return result;
+}
+
+// Whether a little more depth could move the played move across the
+// mistake or blunder line. Lopsided positions are left alone.
+bool ReviewScheduler::nearThreshold(const SearchResult& result) const {
+	if (std::abs(result.score) >= SCHEDULE_DECIDED && std::abs(result.scoredMoveScore) >= SCHEDULE_DECIDED &&
+		(result.score > 0) == (result.scoredMoveScore > 0)) {
+		return false;
+	}
+	int drop = result.score - result.scoredMoveScore;
+	return std::abs(drop - MISTAKE_THRESHOLD) < SCHEDULE_MARGIN || std::abs(drop - BLUNDER_THRESHOLD) < SCHEDULE_MARGIN;
+}
+
+// Takes up to `wanted` from the reserve, but no more than a few times an
+// even split between the plies still to finish
+int64_t ReviewScheduler::claimReserve(int64_t wanted) {
+	int64_t available = reserve.load();
+	while (true) {
+		int64_t fair = available * 3 / std::max(1, unfinished.load());
+		int64_t granted = std::max<int64_t>(0, std::min({wanted, fair, available}));
+		if (reserve.compare_exchange_weak(available, available - granted)) {
+			return granted;
+		}
+	}
+}
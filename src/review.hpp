@@ -0,0 +1,179 @@
+#pragma once
+
+#include "bot.hpp"
+#include "gamerecord.hpp"
+#include <atomic>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+// Called from the worker threads as each ply finishes, in any order
+using PlyCallback = std::function<void(size_t ply, const SearchResult& result)>;
+
+// Splits a time budget for a whole review between its plies, in thread time.
+// Book moves aren't searched unless one of the next two moves needs their
+// evaluation as a baseline, and those and forced moves get a shallow search.
+// The rest start with an even share. Time a search doesn't use goes to a
+// reserve that pays for searching again, with more time, the plies whose
+// played move is close to the mistake or blunder threshold or keeps moving
+// between searches.
+const int SCHEDULE_BASE_PERCENT = 60;
+const int SCHEDULE_FORCED_DEPTH = 6;
+const int SCHEDULE_MAX_EXTENSIONS = 2;
+const int SCHEDULE_MARGIN = PAWN_VALUE / 2;
+const int SCHEDULE_DECIDED = 5 * PAWN_VALUE;
+
+// The first pass of a review searches every ply to a fixed shallow depth.
+// A ply is refined when a drop it takes part in is within the margin of a
+// threshold, widened by how far the scores moved in the pass's last iteration.
+const int REVIEW_SWEEP_DEPTH = 7;
+const int REVIEW_SWEEP_MARGIN = PAWN_VALUE / 2;
+
+// A cached result stands in for a search with a time or node limit once it's
+// this deep, about what a search of a few tens of milliseconds reaches. A
+// search to a fixed depth needs a result at least that deep.
+const int REVIEW_CACHE_DEPTH = 8;
+
+class ReviewScheduler {
+public:
+	ReviewScheduler(const std::vector<Board>& positions, const std::vector<Move>& played,
+		const std::vector<bool>& inBook, const SearchLimits& limits, int64_t milliseconds, int threads = 0,
+		const std::vector<int>& searchedDepths = {});
+
+	// Depth a cached result of the ply needs to be used instead of searching
+	// it. Deeper than `searchedDepths`, the depths an earlier pass reached.
+	int cacheDepth(size_t ply) const { return minDepths[ply]; }
+
+	// Safe to call from several threads for different plies
+	SearchResult search(size_t ply, ThreadData& td, const SearchSeed& seed = SearchSeed());
+
+private:
+	enum PlyKind : uint8_t {
+		PLY_SKIP,
+		PLY_FORCED,
+		PLY_NORMAL
+	};
+
+	bool nearThreshold(const SearchResult& result) const;
+	int64_t claimReserve(int64_t wanted);
+
+	const std::vector<Board>& positions;
+	const std::vector<Move>& played;
+	SearchLimits limits;
+	std::vector<PlyKind> kinds;
+	std::vector<int> minDepths;
+	int64_t share = 0;
+	std::atomic<int64_t> reserve{0};
+	std::atomic<int> unfinished{0};
+};
+
+// Searches the position before every move of a game and scores the move
+// played there. Plies are searched concurrently, one thread each, by up to
+// `threads` workers sharing the transposition table, so neighbouring plies
+// reuse each other's work. 0 threads uses every hardware thread. Results are
+// in ply order. Setting `cancel` stops workers from starting new plies.
+// Plies found in the analysis cache, when it's open, to the depth the limits
+// ask for aren't searched again, and new results are added to it.
+std::vector<SearchResult> analyzeGame(const std::vector<Board>& positions, const std::vector<Move>& played,
+	const SearchLimits& limits, int threads = 0, const PlyCallback& onPly = nullptr,
+	const std::atomic<bool>* cancel = nullptr);
+// Same, with the time per ply decided by a scheduler
+std::vector<SearchResult> analyzeGame(const std::vector<Board>& positions, const std::vector<Move>& played,
+	ReviewScheduler& scheduler, int threads = 0, const PlyCallback& onPly = nullptr,
+	const std::atomic<bool>* cancel = nullptr);
+
+// Per-ply results handed from the analysis threads to a reader. A ply can be
+// published again as better results come in. Each slot is a sequence lock:
+// the reader copies the value and retries if a write overlapped the copy, so
+// it never waits on the writer.
+template <typename T>
+class PlyChannel {
+	static_assert(std::is_trivially_copyable<T>::value, "slots are copied a word at a time");
+
+public:
+	explicit PlyChannel(size_t plies) : slots(plies) {}
+
+	size_t size() const { return slots.size(); }
+
+	// Only one writer per ply at a time
+	void publish(size_t ply, const T& result) {
+		Slot& slot = slots[ply];
+		uint32_t sequence = slot.sequence.load(std::memory_order_relaxed);
+		slot.sequence.store(sequence + 1, std::memory_order_relaxed);
+		std::atomic_thread_fence(std::memory_order_release);
+
+		uint64_t words[WORDS] = {};
+		std::memcpy(words, &result, sizeof(T));
+		for (size_t i = 0; i < WORDS; i++) {
+			slot.words[i].store(words[i], std::memory_order_relaxed);
+		}
+		slot.sequence.store(sequence + 2, std::memory_order_release);
+		if (sequence == 0) {
+			published.fetch_add(1, std::memory_order_release);
+		}
+	}
+
+	// False while the ply is still pending
+	bool tryGet(size_t ply, T& result) const {
+		if (ply >= slots.size()) {
+			return false;
+		}
+		const Slot& slot = slots[ply];
+		while (true) {
+			uint32_t before = slot.sequence.load(std::memory_order_acquire);
+			if (before == 0) {
+				return false;
+			}
+			if (before & 1) {
+				continue;
+			}
+			uint64_t words[WORDS];
+			for (size_t i = 0; i < WORDS; i++) {
+				words[i] = slot.words[i].load(std::memory_order_relaxed);
+			}
+			std::atomic_thread_fence(std::memory_order_acquire);
+			if (slot.sequence.load(std::memory_order_relaxed) == before) {
+				std::memcpy(&result, words, sizeof(T));
+				return true;
+			}
+		}
+	}
+
+	// Plies published at least once
+	size_t publishedCount() const { return published.load(std::memory_order_acquire); }
+
+private:
+	static constexpr size_t WORDS = (sizeof(T) + 7) / 8;
+
+	// Odd while a write is in progress, 0 before the first one
+	struct Slot {
+		std::atomic<uint32_t> sequence{0};
+		std::atomic<uint64_t> words[WORDS];
+	};
+
+	std::vector<Slot> slots;
+	std::atomic<size_t> published{0};
+};
+
+// Evaluation drops, in centipawns, that classify a move
+const int MISTAKE_THRESHOLD = PAWN_VALUE;
+const int BLUNDER_THRESHOLD = 2 * PAWN_VALUE;
+
+// Fills in the best move and evaluation of a ply from its search
+void recordResult(GameRecord& game, size_t ply, const SearchResult& result);
+// Classifies the move played from `board`, the position before `ply`, from
+// the evaluations in the record. Only `player`'s moves are classified.
+Classification classifyMove(const GameRecord& game, const Board& board, size_t ply, Color player);
+const char* classificationName(Classification cl);
+
+// Reviews a game for one player within about `milliseconds`, filling in the
+// analysis of `game` and publishing each ply to `channel` as it's ready. A
+// quick shallow pass publishes every ply as provisional, then the plies whose
+// classification could still change are searched again and republished.
+// The limits cap the depth and nodes of each search. Meant to run on its own
+// thread, with other threads reading the analysis from the channel only.
+void reviewGame(GameRecord& game, Color player, const SearchLimits& limits, int64_t milliseconds, int threads,
+	PlyChannel<PlyAnalysis>& channel, const std::atomic<bool>& cancel);
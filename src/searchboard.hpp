@@ -0,0 +1,132 @@
+#pragma once
+
+#include "chess.hpp"
+#include "keys.hpp"
+#include "nnue.hpp"
+#include "psqt.hpp"
+#include <array>
+
+using namespace chess;
+
+const int MAX_PLY = 128;
+
+// Board used by a search thread. The search only ever makes and unmakes moves
+// on one instance, so the state stack is reserved up front and makeMove never
+// has to grow it.
+//
+// It also keeps the piece-square sums, the pawn and material hashes, and the
+// network accumulator when a network is loaded, up to date as pieces are
+// placed and removed, which makes a static evaluation cheap.
+class SearchBoard : public Board {
+public:
+	static const int STACK_RESERVE = 4 * MAX_PLY;
+
+	explicit SearchBoard(const Board& board) : Board(board) {
+		reserveStack();
+		refreshEvaluation();
+	}
+
+	void setFen(std::string_view fen) override {
+		Board::setFen(fen);
+		reserveStack();
+		refreshEvaluation();
+	}
+
+	void reserveStack() {
+		prev_states_.reserve(prev_states_.size() + STACK_RESERVE);
+	}
+
+	// Tapered score from white's point of view
+	int psqtScore() const {
+		return taper(midgame, endgame, gamePhase);
+	}
+
+	int phase() const {
+		return gamePhase;
+	}
+
+	uint64_t pawnKey() const {
+		return pawnHash;
+	}
+
+	uint64_t materialKey() const {
+		return materialHash;
+	}
+
+	int count(Piece piece) const {
+		return pieceCounts[int(piece)];
+	}
+
+	bool usesNnue() const {
+		return useNnue;
+	}
+
+	int nnueScore() const {
+		return nnueNetwork.evaluate(accumulator, sideToMove());
+	}
+
+	// Rebuild the sums from scratch. Needed after anything that changes the
+	// board without going through placePiece/removePiece, which includes
+	// construction since the base constructor can't call our overrides.
+	void refreshEvaluation() {
+		midgame = 0;
+		endgame = 0;
+		gamePhase = 0;
+		pawnHash = 0;
+		materialHash = 0;
+		pieceCounts.fill(0);
+		Bitboard occupied = occ();
+		while (occupied) {
+			Square sq = occupied.pop();
+			add(at(sq), sq);
+		}
+
+		useNnue = nnueNetwork.loaded();
+		if (useNnue) {
+			nnueNetwork.refresh(*this, accumulator);
+		}
+	}
+
+protected:
+	void placePiece(Piece piece, Square sq) override {
+		Board::placePiece(piece, sq);
+		if (useNnue) {
+			nnueNetwork.addPiece(accumulator, piece, sq);
+		}
+		add(piece, sq);
+	}
+
+	void removePiece(Piece piece, Square sq) override {
+		Board::removePiece(piece, sq);
+		if (useNnue) {
+			nnueNetwork.removePiece(accumulator, piece, sq);
+		}
+		midgame -= PSQT_MG[int(piece)][sq.index()];
+		endgame -= PSQT_EG[int(piece)][sq.index()];
+		gamePhase -= PHASE_WEIGHT[int(piece.type())];
+		materialHash ^= MATERIAL_KEYS[int(piece)][--pieceCounts[int(piece)]];
+		if (piece.type() == PieceType::PAWN) {
+			pawnHash ^= PAWN_KEYS[int(piece.color())][sq.index()];
+		}
+	}
+
+private:
+	void add(Piece piece, Square sq) {
+		midgame += PSQT_MG[int(piece)][sq.index()];
+		endgame += PSQT_EG[int(piece)][sq.index()];
+		gamePhase += PHASE_WEIGHT[int(piece.type())];
+		materialHash ^= MATERIAL_KEYS[int(piece)][pieceCounts[int(piece)]++];
+		if (piece.type() == PieceType::PAWN) {
+			pawnHash ^= PAWN_KEYS[int(piece.color())][sq.index()];
+		}
+	}
+
+	int midgame = 0;
+	int endgame = 0;
+	int gamePhase = 0;
+	uint64_t pawnHash = 0;
+	uint64_t materialHash = 0;
+	std::array<int, 12> pieceCounts = {};
+	bool useNnue = false;
+	NnueAccumulator accumulator;
+};
@@ -0,0 +1,83 @@
+#include "see.hpp"
+#include "bot.hpp"
+#include <algorithm>
+
+static Square leastValuableAttacker(const Board& board, Bitboard attackers, Color side, PieceType& type) {
+	for (PieceType candidate : {PieceType::PAWN, PieceType::KNIGHT, PieceType::BISHOP,
+								PieceType::ROOK, PieceType::QUEEN, PieceType::KING}) {
+		Bitboard pieces = attackers & board.pieces(candidate, side);
+		if (pieces) {
+			type = candidate;
+			return pieces.lsb();
+		}
+	}
+	type = PieceType::NONE;
+	return Square::underlying::NO_SQ;
+}
+
+int staticExchange(const Board& board, Move move) {
+	if (move.typeOf() == Move::CASTLING) {
+		return 0;
+	}
+
+	Square from = move.from();
+	Square to = move.to();
+	Bitboard occ = board.occ() ^ Bitboard::fromSquare(from);
+
+	int gain[32];
+	int depth = 0;
+	// Piece::NONE reports PAWN as its type, so empty squares need checking
+	gain[0] = board.at(to) == Piece::NONE ? 0 : getPieceValue(board.at<PieceType>(to));
+	int attackerValue = getPieceValue(board.at<PieceType>(from));
+
+	if (move.typeOf() == Move::ENPASSANT) {
+		gain[0] = getPieceValue(PieceType::PAWN);
+		occ ^= Bitboard::fromSquare(to.ep_square());
+	}
+	else if (move.typeOf() == Move::PROMOTION) {
+		int promoted = getPieceValue(move.promotionType());
+		gain[0] += promoted - getPieceValue(PieceType::PAWN);
+		attackerValue = promoted;
+	}
+
+	Bitboard diagonal = board.pieces(PieceType::BISHOP) | board.pieces(PieceType::QUEEN);
+	Bitboard straight = board.pieces(PieceType::ROOK) | board.pieces(PieceType::QUEEN);
+	Bitboard attackers = attacks::attackers(board, Color::WHITE, to) | attacks::attackers(board, Color::BLACK, to);
+	attackers |= (attacks::bishop(to, occ) & diagonal) | (attacks::rook(to, occ) & straight);
+	attackers &= occ;
+	Color side = ~board.sideToMove();
+
+	while (depth < 31) {
+		depth++;
+		// Speculative gain if the piece on the square gets captured next
+		gain[depth] = attackerValue - gain[depth - 1];
+		if (std::max(-gain[depth - 1], gain[depth]) < 0) {
+			break;
+		}
+
+		PieceType type;
+		Square square = leastValuableAttacker(board, attackers & occ, side, type);
+		if (type == PieceType::NONE) {
+			break;
+		}
+
+		// Removing the capturing piece can uncover sliders behind it
+		occ ^= Bitboard::fromSquare(square);
+		if (type == PieceType::PAWN || type == PieceType::BISHOP || type == PieceType::QUEEN) {
+			attackers |= attacks::bishop(to, occ) & diagonal;
+		}
+		if (type == PieceType::ROOK || type == PieceType::QUEEN) {
+			attackers |= attacks::rook(to, occ) & straight;
+		}
+		attackers &= occ;
+
+		attackerValue = getPieceValue(type);
+		side = ~side;
+	}
+
+	// The last entry is a capture nobody was able to make
+	while (--depth) {
+		gain[depth - 1] = -std::max(-gain[depth - 1], gain[depth]);
+	}
+	return gain[0];
+}
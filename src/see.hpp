@@ -0,0 +1,10 @@
+#pragma once
+
+#include "chess.hpp"
+
+using namespace chess;
+
+// Static exchange evaluation: the material the side to move gains from
+// playing the move and then trading off on its target square, with both
+// sides free to stop capturing when it stops paying. Pins are ignored.
+int staticExchange(const Board& board, Move move);
@@ -0,0 +1,320 @@
+#include "tablebase.hpp"
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+#include <filesystem>
+
+Tablebases tablebases;
+
+constexpr PieceType MATERIAL_ORDER[5] = {PieceType::PAWN, PieceType::KNIGHT, PieceType::BISHOP, PieceType::ROOK, PieceType::QUEEN};
+
+// Piece counts of both sides, 4 bits each, with the given side first
+static uint64_t materialKey(const Board& board, Color first) {
+	uint64_t key = 0;
+	int shift = 0;
+	for (Color side : {first, ~first}) {
+		for (PieceType type : MATERIAL_ORDER) {
+			key |= uint64_t(board.pieces(type, side).count()) << shift;
+			shift += 4;
+		}
+	}
+	return key;
+}
+
+static uint64_t materialKey(const TablebaseLayout& layout) {
+	uint64_t key = 0;
+	for (Piece piece : layout.pieces) {
+		if (piece.type() == PieceType::KING) {
+			continue;
+		}
+		int type = std::find(MATERIAL_ORDER, MATERIAL_ORDER + 5, piece.type()) - MATERIAL_ORDER;
+		int shift = (piece.color() == Color::WHITE ? 0 : 20) + type * 4;
+		key += uint64_t(1) << shift;
+	}
+	return key;
+}
+
+static void pieceFromLetter(char letter, Color side, Piece& piece) {
+	const char* letters = "PNBRQK";
+	int type = int(std::strchr(letters, letter) - letters);
+	piece = Piece(PieceType(static_cast<PieceType::underlying>(type)), side);
+}
+
+// Placements of the two kings that an index covers, numbered, for tables
+// without pawns (strong king in the a1-d1-d4 triangle) and with them
+// (strong king on files a to d). Touching kings are left out.
+struct KingPairs {
+	int16_t index[2][64][64];
+	std::vector<std::pair<uint8_t, uint8_t>> squares[2];
+
+	KingPairs() {
+		for (int pawns = 0; pawns < 2; pawns++) {
+			for (int strong = 0; strong < 64; strong++) {
+				int file = strong & 7;
+				int rank = strong >> 3;
+				bool covered = pawns ? file < 4 : file < 4 && rank <= file;
+				for (int weak = 0; weak < 64; weak++) {
+					index[pawns][strong][weak] = -1;
+					bool touching = std::abs((weak & 7) - file) <= 1 && std::abs((weak >> 3) - rank) <= 1;
+					bool belowDiagonal = pawns || rank != file || (weak >> 3) <= (weak & 7);
+					if (covered && !touching && belowDiagonal) {
+						index[pawns][strong][weak] = int16_t(squares[pawns].size());
+						squares[pawns].emplace_back(uint8_t(strong), uint8_t(weak));
+					}
+				}
+			}
+		}
+	}
+};
+
+static const KingPairs& kingPairs() {
+	static const KingPairs pairs;
+	return pairs;
+}
+
+bool parseTablebaseName(const std::string& name, TablebaseLayout& layout) {
+	size_t separator = name.find('v');
+	if (separator == std::string::npos) {
+		return false;
+	}
+
+	layout.pieces.clear();
+	layout.hasPawns = false;
+	std::string sides[2] = {name.substr(0, separator), name.substr(separator + 1)};
+	for (int side = 0; side < 2; side++) {
+		Color color = side == 0 ? Color::WHITE : Color::BLACK;
+		if (sides[side].empty() || sides[side][0] != 'K') {
+			return false;
+		}
+		std::string rest = sides[side].substr(1);
+		if (rest.find_first_not_of("QRBNP") != std::string::npos) {
+			return false;
+		}
+		// Strongest first, so identical pieces end up next to each other
+		std::sort(rest.begin(), rest.end(), [](char a, char b) {
+			return std::strchr("QRBNP", a) < std::strchr("QRBNP", b);
+		});
+		sides[side] = "K" + rest;
+
+		if (side == 1) {
+			layout.weakKing = layout.pieces.size();
+		}
+		for (char letter : sides[side]) {
+			Piece piece;
+			pieceFromLetter(letter, color, piece);
+			layout.pieces.push_back(piece);
+			layout.hasPawns |= piece.type() == PieceType::PAWN;
+		}
+	}
+
+	if (layout.pieces.size() < 3 || layout.pieces.size() > size_t(TABLEBASE_MAX_PIECES)) {
+		return false;
+	}
+	layout.name = sides[0] + "v" + sides[1];
+	layout.entries = 2 * kingPairs().squares[layout.hasPawns].size();
+	for (size_t i = 1; i < layout.pieces.size(); i++) {
+		if (i != layout.weakKing) {
+			layout.entries *= layout.pieces[i].type() == PieceType::PAWN ? 48 : 64;
+		}
+	}
+	return true;
+}
+
+static void transform(Square* squares, size_t count, int (*map)(int)) {
+	for (size_t i = 0; i < count; i++) {
+		squares[i] = Square(map(squares[i].index()));
+	}
+}
+
+static int mirrorFile(int sq) { return sq ^ 7; }
+static int mirrorRank(int sq) { return sq ^ 56; }
+static int transpose(int sq) { return (sq & 7) << 3 | sq >> 3; }
+static bool onDiagonal(Square sq) { return int(sq.file()) == int(sq.rank()); }
+
+static void sortGroups(const TablebaseLayout& layout, Square* squares) {
+	size_t count = layout.pieces.size();
+	for (size_t i = 1; i < count;) {
+		size_t end = i + 1;
+		while (end < count && layout.pieces[end] == layout.pieces[i]) {
+			end++;
+		}
+		std::sort(squares + i, squares + end, [](Square a, Square b) { return a.index() < b.index(); });
+		i = end;
+	}
+}
+
+// Index of squares already in the covered king placements
+static uint64_t encode(const TablebaseLayout& layout, const Square* squares, Color sideToMove) {
+	int pair = kingPairs().index[layout.hasPawns][squares[0].index()][squares[layout.weakKing].index()];
+	if (pair < 0) {
+		return TABLEBASE_NO_INDEX;
+	}
+	uint64_t index = uint64_t(pair);
+	for (size_t i = 1; i < layout.pieces.size(); i++) {
+		if (i == layout.weakKing) {
+			continue;
+		}
+		if (layout.pieces[i].type() == PieceType::PAWN) {
+			int rank = squares[i].rank();
+			if (rank == 0 || rank == 7) {
+				return TABLEBASE_NO_INDEX;
+			}
+			index = index * 48 + (squares[i].index() - 8);
+		}
+		else {
+			index = index * 64 + squares[i].index();
+		}
+	}
+	return index * 2 + (sideToMove == Color::BLACK ? 1 : 0);
+}
+
+uint64_t tablebaseIndex(const TablebaseLayout& layout, Square* squares, Color sideToMove) {
+	size_t count = std::min(layout.pieces.size(), size_t(TABLEBASE_MAX_PIECES));
+	if (squares[0].file() > File::FILE_D) {
+		transform(squares, count, mirrorFile);
+	}
+	if (!layout.hasPawns) {
+		if (int(squares[0].rank()) > 3) {
+			transform(squares, count, mirrorRank);
+		}
+		if (int(squares[0].rank()) > int(squares[0].file())) {
+			transform(squares, count, transpose);
+		}
+		Square weak = squares[layout.weakKing];
+		if (onDiagonal(squares[0]) && int(weak.rank()) > int(weak.file())) {
+			transform(squares, count, transpose);
+		}
+	}
+	sortGroups(layout, squares);
+	uint64_t index = encode(layout, squares, sideToMove);
+
+	// Both kings on the diagonal leave the other pieces free to be reflected
+	if (!layout.hasPawns && onDiagonal(squares[0]) && onDiagonal(squares[layout.weakKing])) {
+		Square reflected[TABLEBASE_MAX_PIECES];
+		std::copy(squares, squares + count, reflected);
+		transform(reflected, count, transpose);
+		sortGroups(layout, reflected);
+		uint64_t reflectedIndex = encode(layout, reflected, sideToMove);
+		if (reflectedIndex < index) {
+			std::copy(reflected, reflected + count, squares);
+			index = reflectedIndex;
+		}
+	}
+	return index;
+}
+
+void tablebaseDecode(const TablebaseLayout& layout, uint64_t index, Square* squares, Color& sideToMove) {
+	sideToMove = (index & 1) ? Color::BLACK : Color::WHITE;
+	index >>= 1;
+	for (size_t i = layout.pieces.size() - 1; i > 0; i--) {
+		if (i == layout.weakKing) {
+			continue;
+		}
+		if (layout.pieces[i].type() == PieceType::PAWN) {
+			squares[i] = Square(int(index % 48) + 8);
+			index /= 48;
+		}
+		else {
+			squares[i] = Square(int(index % 64));
+			index /= 64;
+		}
+	}
+	const std::pair<uint8_t, uint8_t>& pair = kingPairs().squares[layout.hasPawns][index];
+	squares[0] = Square(int(pair.first));
+	squares[layout.weakKing] = Square(int(pair.second));
+}
+
+static bool validFile(const MappedFile& file, TablebaseKind kind, const TablebaseLayout& layout, uint64_t payload) {
+	if (file.size() != sizeof(TablebaseHeader) + payload) {
+		return false;
+	}
+	TablebaseHeader header;
+	std::memcpy(&header, file.data(), sizeof(header));
+	return std::memcmp(header.magic, "CRTB", 4) == 0
+		&& header.kind == kind
+		&& std::strncmp(header.name, layout.name.c_str(), sizeof(header.name)) == 0
+		&& header.entries == layout.entries;
+}
+
+int Tablebases::load(const std::string& directory) {
+	int loaded = 0;
+	std::error_code error;
+	for (const auto& entry : std::filesystem::directory_iterator(directory, error)) {
+		std::filesystem::path path = entry.path();
+		if (path.extension() != ".wdl") {
+			continue;
+		}
+
+		auto table = std::make_unique<Table>();
+		if (!parseTablebaseName(path.stem().string(), table->layout)) {
+			continue;
+		}
+		std::filesystem::path dtcPath = path;
+		dtcPath.replace_extension(".dtc");
+		if (!table->wdl.open(path.string()) || !table->dtc.open(dtcPath.string())) {
+			continue;
+		}
+		const TablebaseLayout& layout = table->layout;
+		if (!validFile(table->wdl, TABLEBASE_WDL, layout, (layout.entries + 3) / 4)
+			|| !validFile(table->dtc, TABLEBASE_DTC, layout, layout.entries)) {
+			continue;
+		}
+
+		largest = std::max(largest, int(layout.pieces.size()));
+		tables[materialKey(layout)] = std::move(table);
+		loaded++;
+	}
+	return loaded;
+}
+
+bool Tablebases::probe(const Board& board, TablebaseResult& result) const {
+	int count = board.occ().count();
+	if (count == 2) {
+		result = TablebaseResult();
+		return true;
+	}
+	if (count > largest || board.enpassantSq() != Square::underlying::NO_SQ || !board.castlingRights().isEmpty()) {
+		return false;
+	}
+
+	bool flipped = false;
+	auto found = tables.find(materialKey(board, Color::WHITE));
+	if (found == tables.end()) {
+		found = tables.find(materialKey(board, Color::BLACK));
+		flipped = true;
+		if (found == tables.end()) {
+			return false;
+		}
+	}
+	const Table& table = *found->second;
+	const TablebaseLayout& layout = table.layout;
+
+	// Identical pieces are consecutive in the layout, so a whole group is
+	// filled from its bitboard the first time the piece comes up
+	Square squares[TABLEBASE_MAX_PIECES];
+	size_t filled = 0;
+	while (filled < layout.pieces.size()) {
+		Piece piece = layout.pieces[filled];
+		Color color = flipped ? ~piece.color() : piece.color();
+		Bitboard pieces = board.pieces(piece.type(), color);
+		while (pieces) {
+			int sq = pieces.pop();
+			squares[filled++] = Square(flipped ? sq ^ 56 : sq);
+		}
+	}
+	Color sideToMove = flipped ? ~board.sideToMove() : board.sideToMove();
+	uint64_t index = tablebaseIndex(layout, squares, sideToMove);
+	if (index == TABLEBASE_NO_INDEX) {
+		return false;
+	}
+
+	const uint8_t* wdl = table.wdl.data() + sizeof(TablebaseHeader);
+	const uint8_t* dtc = table.dtc.data() + sizeof(TablebaseHeader);
+	TablebaseWdl value = TablebaseWdl((wdl[index / 4] >> (index % 4 * 2)) & 3);
+	if (value == TB_UNUSED) {
+		return false;
+	}
+	result.wdl = value;
+	result.distance = dtc[index];
+	return true;
+}
@@ -0,0 +1,108 @@
+#pragma once
+
+#include "chess.hpp"
+#include "mappedfile.hpp"
+#include <cstdint>
+#include <memory>
+#include <string>
+#include <unordered_map>
+#include <vector>
+
+using namespace chess;
+
+// Endgame tablebases generated locally by chessreview-tbgen.
+//
+// A table covers one material configuration, named like "KRvK" with the
+// stronger side first. Positions with the colours the other way round are
+// probed by flipping the board. Each table is a pair of files:
+//
+//     <name>.wdl   2 bits per position: 0 draw, 1 win, 2 loss, 3 unused
+//     <name>.dtc   1 byte per position: plies to mate or to a capture or
+//                  promotion that leaves the table, saturating at 255
+//
+// both starting with a TablebaseHeader. Results are from the side to move's
+// point of view. Tables ignore castling and en passant rights, and the 50
+// move rule.
+
+const int TABLEBASE_MAX_PIECES = 5;
+
+enum TablebaseKind : uint32_t {
+	TABLEBASE_WDL = 0,
+	TABLEBASE_DTC = 1
+};
+
+enum TablebaseWdl : uint8_t {
+	TB_DRAW = 0,
+	TB_WIN = 1,
+	TB_LOSS = 2,
+	TB_UNUSED = 3
+};
+
+struct TablebaseHeader {
+	char magic[4];
+	uint32_t kind;
+	char name[16];
+	uint64_t entries;
+};
+
+// Pieces of a table in index order: the strong side's king and pieces, then
+// the weak side's. "White" here is the strong side. Identical pieces sit
+// next to each other and are stored with ascending squares.
+struct TablebaseLayout {
+	std::string name;
+	std::vector<Piece> pieces;
+	// Position of the weak king in `pieces`
+	size_t weakKing = 0;
+	bool hasPawns = false;
+	uint64_t entries = 0;
+};
+
+bool parseTablebaseName(const std::string& name, TablebaseLayout& layout);
+
+// Index of a position, or TABLEBASE_NO_INDEX when the kings touch or a pawn
+// is on the first or last rank. The two kings share one index over the
+// pairs that can occur, other pieces take 64 squares each and pawns 48.
+//
+// Without castling the board is symmetric left to right, and without pawns
+// top to bottom and along the diagonals too. The strong king is moved to
+// files a to d, and without pawns into the a1-d1-d4 triangle. When it ends
+// up on the a1-h8 diagonal the weak king is moved to or below it, and when
+// both kings are on the diagonal the smaller index of the position and its
+// reflection is used. Same-piece squares are sorted. Squares are reordered
+// in place.
+const uint64_t TABLEBASE_NO_INDEX = ~uint64_t(0);
+
+uint64_t tablebaseIndex(const TablebaseLayout& layout, Square* squares, Color sideToMove);
+// Any position in the index range, whether or not it's the one its own
+// index would pick
+void tablebaseDecode(const TablebaseLayout& layout, uint64_t index, Square* squares, Color& sideToMove);
+
+struct TablebaseResult {
+	TablebaseWdl wdl = TB_DRAW;
+	int distance = 0;
+};
+
+class Tablebases {
+public:
+	// Maps every table in the directory. Returns how many were loaded.
+	int load(const std::string& directory);
+
+	// Largest piece count with a table, including kings
+	int maxPieces() const { return largest; }
+
+	// False when there's no table for the position or it has castling or
+	// en passant rights. A bare king against a bare king is always a draw.
+	bool probe(const Board& board, TablebaseResult& result) const;
+
+private:
+	struct Table {
+		TablebaseLayout layout;
+		MappedFile wdl;
+		MappedFile dtc;
+	};
+
+	std::unordered_map<uint64_t, std::unique_ptr<Table>> tables;
+	int largest = 0;
+};
+
+extern Tablebases tablebases;
@@ -0,0 +1,106 @@
+#include "threadpool.hpp"
+#include <algorithm>
+
+ThreadPool searchPool(std::max(1u, std::thread::hardware_concurrency()));
+
+ThreadPool::ThreadPool(int threadCount) {
+	startThreads(threadCount);
+}
+
+ThreadPool::~ThreadPool() {
+	stopThreads();
+}
+
+void ThreadPool::setThreadCount(int threadCount) {
+	std::lock_guard<std::mutex> searchLock(searchMutex);
+	stopThreads();
+	startThreads(threadCount);
+}
+
+int ThreadPool::threadCount() const {
+	return threadData.size();
+}
+
+void ThreadPool::startThreads(int threadCount) {
+	threadCount = std::max(1, threadCount);
+	quit = false;
+	threadData.clear();
+	for (int i = 0; i < threadCount; i++) {
+		threadData.push_back(std::make_unique<ThreadData>());
+		threadData.back()->id = i;
+	}
+	for (int i = 1; i < threadCount; i++) {
+		helpers.emplace_back(&ThreadPool::workerLoop, this, i);
+	}
+}
+
+void ThreadPool::stopThreads() {
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		quit = true;
+	}
+	wake.notify_all();
+	for (auto& thread : helpers) {
+		thread.join();
+	}
+	helpers.clear();
+}
+
+void ThreadPool::workerLoop(int id) {
+	uint64_t lastSearch = 0;
+	while (true) {
+		std::unique_lock<std::mutex> lock(mutex);
+		wake.wait(lock, [&] { return quit || searchId != lastSearch; });
+		if (quit) {
+			return;
+		}
+		lastSearch = searchId;
+		lock.unlock();
+
+		iterativeDeepening(*rootBoard, *threadData[id]);
+
+		lock.lock();
+		if (--running == 0) {
+			done.notify_all();
+		}
+	}
+}
+
+SearchResult ThreadPool::search(const Board& board, const SearchLimits& limits, const SearchOptions& options, Move scoredMove) {
+	std::lock_guard<std::mutex> searchLock(searchMutex);
+	transpositionTable.newSearch();
+
+	SearchContext context;
+	context.limits = limits;
+	context.options = options;
+	context.scoredMove = scoredMove;
+	context.startTime = std::chrono::steady_clock::now();
+	for (auto& td : threadData) {
+		td->context = &context;
+		td->nodes = 0;
+		td->ordering.newSearch();
+	}
+
+	{
+		std::lock_guard<std::mutex> lock(mutex);
+		rootBoard = &board;
+		running = helpers.size();
+		searchId++;
+	}
+	wake.notify_all();
+
+	SearchResult result = iterativeDeepening(board, *threadData[0]);
+
+	context.stop = true;
+	{
+		std::unique_lock<std::mutex> lock(mutex);
+		done.wait(lock, [&] { return running == 0; });
+	}
+
+	// A helper may have completed a deeper iteration than the main thread
+	if (context.result.depth > result.depth) {
+		result = context.result;
+	}
+	result.nodes = context.nodes;
+	return result;
+}
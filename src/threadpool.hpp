@@ -0,0 +1,42 @@
+#pragma once
+
+#include "bot.hpp"
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+// Persistent search threads. The calling thread acts as the main search
+// thread and the pool's threads join it as Lazy SMP helpers.
+class ThreadPool {
+public:
+	explicit ThreadPool(int threadCount);
+	~ThreadPool();
+
+	void setThreadCount(int threadCount);
+	int threadCount() const;
+
+	SearchResult search(const Board& board, const SearchLimits& limits, const SearchOptions& options, Move scoredMove = Move::NO_MOVE);
+
+private:
+	void startThreads(int threadCount);
+	void stopThreads();
+	void workerLoop(int id);
+
+	std::vector<std::unique_ptr<ThreadData>> threadData;
+	std::vector<std::thread> helpers;
+
+	// Only one search runs on the pool at a time
+	std::mutex searchMutex;
+
+	std::mutex mutex;
+	std::condition_variable wake;
+	std::condition_variable done;
+	uint64_t searchId = 0;
+	int running = 0;
+	bool quit = false;
+	const Board* rootBoard = nullptr;
+};
+
+extern ThreadPool searchPool;
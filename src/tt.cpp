@@ -0,0 +1,107 @@
+#include "tt.hpp"
+#include "bot.hpp"
+
+// Packed layout: move (16) | score (16) | depth (8) | bound (2) | generation (6)
+static uint64_t pack(int depth, Bound bound, int score, Move move, uint8_t generation) {
+	return uint64_t(move.move())
+		| (uint64_t(uint16_t(int16_t(score))) << 16)
+		| (uint64_t(uint8_t(int8_t(depth))) << 32)
+		| (uint64_t(bound) << 40)
+		| (uint64_t(generation & 0x3F) << 42);
+}
+
+static TTEntry unpack(uint64_t data) {
+	TTEntry entry;
+	entry.move = Move(uint16_t(data));
+	entry.score = int16_t(uint16_t(data >> 16));
+	entry.depth = int8_t(uint8_t(data >> 32));
+	entry.bound = Bound((data >> 40) & 3);
+	return entry;
+}
+
+static uint8_t generationOf(uint64_t data) {
+	return (data >> 42) & 0x3F;
+}
+
+TranspositionTable::TranspositionTable(size_t megabytes) {
+	resize(megabytes);
+}
+
+void TranspositionTable::resize(size_t megabytes) {
+	size_t count = 1;
+	while (count * 2 * sizeof(Slot) <= megabytes * 1024 * 1024) {
+		count *= 2;
+	}
+	slots.reset(new Slot[count]);
+	mask = count - 1;
+	clear();
+}
+
+void TranspositionTable::clear() {
+	for (size_t i = 0; i <= mask; i++) {
+		slots[i].check.store(0, std::memory_order_relaxed);
+		slots[i].data.store(0, std::memory_order_relaxed);
+	}
+	generation = 0;
+}
+
+void TranspositionTable::newSearch() {
+	generation = (generation + 1) & 0x3F;
+}
+
+bool TranspositionTable::probe(uint64_t key, TTEntry& entry) const {
+	const Slot& slot = slots[key & mask];
+	uint64_t data = slot.data.load(std::memory_order_relaxed);
+	uint64_t check = slot.check.load(std::memory_order_relaxed);
+	if ((check ^ data) != key || data == 0) {
+		return false;
+	}
+	entry = unpack(data);
+	return true;
+}
+
+void TranspositionTable::store(uint64_t key, int depth, Bound bound, int score, Move move) {
+	Slot& slot = slots[key & mask];
+	uint64_t oldData = slot.data.load(std::memory_order_relaxed);
+	uint64_t oldCheck = slot.check.load(std::memory_order_relaxed);
+
+	if (oldData != 0 && generationOf(oldData) == generation) {
+		TTEntry old = unpack(oldData);
+		bool sameKey = (oldCheck ^ oldData) == key;
+		// Keep deeper results from the current search unless this one is exact
+		if (bound != BOUND_EXACT && depth < old.depth) {
+			return;
+		}
+		// Don't lose a known best move to a fail-low store of the same position
+		if (sameKey && move == Move::NO_MOVE) {
+			move = old.move;
+		}
+	}
+
+	uint64_t data = pack(depth, bound, score, move, generation);
+	slot.check.store(key ^ data, std::memory_order_relaxed);
+	slot.data.store(data, std::memory_order_relaxed);
+}
+
+// Mate and tablebase scores are stored relative to the node instead of the
+// root, so the same entry stays correct when the position is reached at a
+// different ply.
+int scoreToTT(int score, int ply) {
+	if (score >= TB_BOUND) {
+		return score + ply;
+	}
+	if (score <= -TB_BOUND) {
+		return score - ply;
+	}
+	return score;
+}
+
+int scoreFromTT(int score, int ply) {
+	if (score >= TB_BOUND) {
+		return score - ply;
+	}
+	if (score <= -TB_BOUND) {
+		return score + ply;
+	}
+	return score;
+}
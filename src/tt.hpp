@@ -0,0 +1,50 @@
+#pragma once
+
+#include "chess.hpp"
+#include <atomic>
+#include <cstdint>
+#include <memory>
+
+using namespace chess;
+
+enum Bound : uint8_t {
+	BOUND_NONE,
+	BOUND_UPPER,
+	BOUND_LOWER,
+	BOUND_EXACT
+};
+
+struct TTEntry {
+	Move move;
+	int score;
+	int depth;
+	Bound bound;
+};
+
+// Fixed-size hash table shared by every search thread. Each slot holds the
+// packed entry data and the key XORed with that data, so a torn read from a
+// concurrent store fails verification instead of returning a mixed entry.
+class TranspositionTable {
+public:
+	explicit TranspositionTable(size_t megabytes);
+
+	void resize(size_t megabytes);
+	void clear();
+	void newSearch();
+
+	bool probe(uint64_t key, TTEntry& entry) const;
+	void store(uint64_t key, int depth, Bound bound, int score, Move move);
+
+private:
+	struct Slot {
+		std::atomic<uint64_t> check;
+		std::atomic<uint64_t> data;
+	};
+
+	std::unique_ptr<Slot[]> slots;
+	size_t mask = 0;
+	uint8_t generation = 0;
+};
+
+int scoreToTT(int score, int ply);
+int scoreFromTT(int score, int ply);
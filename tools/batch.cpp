@@ -0,0 +1,285 @@
+#include "analysiscache.hpp"
+#include "bot.hpp"
+#include "nnue.hpp"
+#include "review.hpp"
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <string>
+#include <vector>
+
+// Headless review of PGN games, for both players. Games are read with the
+// library's streaming PGN parser and reviewed a batch at a time: the plies
+// of every game in the batch are searched together across all cores, so
+// short games and the tail of long ones don't leave threads idle. Results
+// are written in game order, one line per ply.
+
+const size_t BATCH_GAMES = 32;
+
+struct GameInput {
+	int number = 0;
+	std::string white;
+	std::string black;
+	std::string fen;
+	std::vector<std::string> moves;
+};
+
+// Collects games from the parser and hands them over a batch at a time
+class GameCollector : public pgn::Visitor {
+public:
+	explicit GameCollector(std::function<void(std::vector<GameInput>&)> onBatch) : onBatch(std::move(onBatch)) {}
+
+	void startPgn() override {
+		game = GameInput();
+		game.number = ++count;
+	}
+
+	void header(std::string_view key, std::string_view value) override {
+		if (key == "White") {
+			game.white = value;
+		} else if (key == "Black") {
+			game.black = value;
+		} else if (key == "FEN") {
+			game.fen = value;
+		}
+	}
+
+	void startMoves() override {}
+
+	void move(std::string_view san, std::string_view) override {
+		game.moves.emplace_back(san);
+	}
+
+	void endPgn() override {
+		games.push_back(std::move(game));
+		if (games.size() >= BATCH_GAMES) {
+			flush();
+		}
+	}
+
+	void flush() {
+		if (!games.empty()) {
+			onBatch(games);
+			games.clear();
+		}
+	}
+
+private:
+	std::function<void(std::vector<GameInput>&)> onBatch;
+	std::vector<GameInput> games;
+	GameInput game;
+	int count = 0;
+};
+
+static std::string jsonString(const std::string& text) {
+	std::string out = "\"";
+	for (char c : text) {
+		if (c == '"' || c == '\\') {
+			out += '\\';
+			out += c;
+		} else if (static_cast<unsigned char>(c) < 0x20) {
+			char escaped[8];
+			std::snprintf(escaped, sizeof(escaped), "\\u%04x", c);
+			out += escaped;
+		} else {
+			out += c;
+		}
+	}
+	return out + "\"";
+}
+
+static std::string csvField(const std::string& text) {
+	if (text.find_first_of(",\"\n") == std::string::npos) {
+		return text;
+	}
+	std::string out = "\"";
+	for (char c : text) {
+		out += c;
+		if (c == '"') {
+			out += '"';
+		}
+	}
+	return out + "\"";
+}
+
+struct BatchSettings {
+	SearchLimits limits;
+	// Time per game shared out by a ReviewScheduler, instead of a fixed time per ply
+	int64_t budget = 0;
+	int threads = 0;
+	bool csv = false;
+};
+
+// Reviews a batch and writes its plies. Games with a move that doesn't parse
+// are reported and skipped.
+static size_t reviewBatch(std::vector<GameInput>& games, const OpeningBook& book, const BatchSettings& settings, std::ostream& out) {
+	std::vector<GameRecord> records;
+	std::vector<GameInput*> valid;
+	for (GameInput& game : games) {
+		try {
+			records.emplace_back(game.moves, game.fen.empty() ? Board() : Board(game.fen));
+		} catch (const std::exception& e) {
+			std::cerr << "Skipping game " << game.number << ": " << e.what() << std::endl;
+			continue;
+		}
+		records.back().markBook(book);
+		valid.push_back(&game);
+	}
+
+	// The plies of every game go into one list, so they're searched together
+	std::vector<Board> positions;
+	std::vector<Move> played;
+	std::vector<bool> inBook;
+	std::vector<size_t> firstPly;
+	for (const GameRecord& record : records) {
+		firstPly.push_back(positions.size());
+		std::vector<Board> gamePositions = record.positions();
+		positions.insert(positions.end(), gamePositions.begin(), gamePositions.end());
+		played.insert(played.end(), record.moves.begin(), record.moves.end());
+		for (size_t i = 0; i < record.size(); i++) {
+			inBook.push_back(record.inBook(i));
+		}
+	}
+
+	std::vector<SearchResult> results;
+	if (settings.budget > 0) {
+		SearchLimits limits = settings.limits;
+		limits.milliseconds = 0;
+		ReviewScheduler scheduler(positions, played, inBook, limits, settings.budget * int64_t(valid.size()), settings.threads);
+		results = analyzeGame(positions, played, scheduler, settings.threads);
+	} else {
+		results = analyzeGame(positions, played, settings.limits, settings.threads);
+	}
+
+	for (size_t g = 0; g < valid.size(); g++) {
+		const GameInput& game = *valid[g];
+		GameRecord& record = records[g];
+		size_t start = firstPly[g];
+		for (size_t i = 0; i < record.size(); i++) {
+			recordResult(record, i, results[start + i]);
+		}
+
+		for (size_t i = 0; i < record.size(); i++) {
+			const Board& board = positions[start + i];
+			// Both players are reviewed, each ply for the side that made it
+			Classification cl = classifyMove(record, board, i, record.sideToMove(i));
+			int eval = record.analysis[i].evaluation;
+			Move bestMove = record.analysis[i].bestMove;
+			std::string best = bestMove == Move::NO_MOVE ? "" : uci::moveToSan(board, bestMove);
+
+			if (settings.csv) {
+				out << game.number << ',' << csvField(game.white) << ',' << csvField(game.black) << ',' << i + 1 << ','
+					<< csvField(game.moves[i]) << ',' << eval << ',' << csvField(best) << ',' << classificationName(cl) << '\n';
+			} else {
+				out << "{\"game\":" << game.number << ",\"white\":" << jsonString(game.white) << ",\"black\":"
+					<< jsonString(game.black) << ",\"ply\":" << i + 1 << ",\"san\":" << jsonString(game.moves[i])
+					<< ",\"eval\":" << eval << ",\"best\":" << jsonString(best) << ",\"class\":\""
+					<< classificationName(cl) << "\"}\n";
+			}
+		}
+	}
+	out.flush();
+	return positions.size();
+}
+
+// Usage: chessreview-batch [options] [games.pgn]
+//   Reads standard input without a file. Evaluations are in centipawns from
+//   white's point of view after the move; mates are 32000 minus the plies.
+//   --csv               CSV instead of JSON lines
+//   --time <ms>         search time per ply, default 500
+//   --budget <ms>       review time per game, shared out between its plies
+//   --depth <plies>     search depth limit per ply
+//   --nodes <count>     node limit per ply
+//   --threads <count>   search threads, default every hardware thread
+//   --book <file>       opening book, Polyglot, binary or text, default opening_book.bin,
+//                       the one the build generated or else opening_book.txt
+//   --cache <file>      analysis cache, default analysis.cache, "" for none
+//   --nnue <file>       network weights, default nnue.bin if present
+//   --tablebases <dir>  endgame tables, default tablebases
+int main(int argc, char** argv) {
+	BatchSettings settings;
+	settings.limits.milliseconds = 500;
+	std::string bookFile;
+	std::string cacheFile = "analysis.cache";
+	std::string nnueFile = "nnue.bin";
+	std::string tablebaseDirectory = "tablebases";
+	std::string input;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--csv") {
+			settings.csv = true;
+		} else if (arg == "--time" && i + 1 < argc) {
+			settings.limits.milliseconds = std::stoll(argv[++i]);
+		} else if (arg == "--budget" && i + 1 < argc) {
+			settings.budget = std::stoll(argv[++i]);
+		} else if (arg == "--depth" && i + 1 < argc) {
+			settings.limits.maxDepth = std::stoi(argv[++i]);
+		} else if (arg == "--nodes" && i + 1 < argc) {
+			settings.limits.nodes = std::stoull(argv[++i]);
+		} else if (arg == "--threads" && i + 1 < argc) {
+			settings.threads = std::stoi(argv[++i]);
+		} else if (arg == "--book" && i + 1 < argc) {
+			bookFile = argv[++i];
+		} else if (arg == "--cache" && i + 1 < argc) {
+			cacheFile = argv[++i];
+		} else if (arg == "--nnue" && i + 1 < argc) {
+			nnueFile = argv[++i];
+		} else if (arg == "--tablebases" && i + 1 < argc) {
+			tablebaseDirectory = argv[++i];
+		} else {
+			input = arg;
+		}
+	}
+
+	if (nnueNetwork.load(nnueFile)) {
+		std::cerr << "Using NNUE evaluation (" << nnueNetwork.simdName() << ")" << std::endl;
+	}
+	int tableCount = tablebases.load(tablebaseDirectory);
+	if (tableCount > 0) {
+		std::cerr << "Loaded " << tableCount << " endgame tablebases" << std::endl;
+	}
+	if (!cacheFile.empty()) {
+		uint16_t cacheVersion = ENGINE_VERSION * 2 + (nnueNetwork.loaded() ? 1 : 0);
+		if (!analysisCache.open(cacheFile, cacheVersion)) {
+			std::cerr << "Failed to open analysis cache " << cacheFile << std::endl;
+		}
+	}
+	OpeningBook book;
+	bool bookLoaded = bookFile.empty() ? book.loadDefault() : book.load(bookFile);
+	if (!bookLoaded) {
+		std::cerr << "Failed to load opening book" << std::endl;
+	}
+
+	std::ifstream file;
+	if (!input.empty()) {
+		file.open(input);
+		if (!file) {
+			std::cerr << "Failed to open " << input << std::endl;
+			return 1;
+		}
+	}
+	std::istream& in = input.empty() ? std::cin : file;
+
+	if (settings.csv) {
+		std::cout << "game,white,black,ply,san,eval,best,class\n";
+	}
+
+	auto start = std::chrono::steady_clock::now();
+	size_t gameCount = 0;
+	size_t plyCount = 0;
+	GameCollector collector([&](std::vector<GameInput>& games) {
+		plyCount += reviewBatch(games, book, settings, std::cout);
+		gameCount += games.size();
+		auto elapsed = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::steady_clock::now() - start);
+		std::cerr << "Reviewed " << gameCount << " games, " << plyCount << " plies in " << elapsed.count() << " s" << std::endl;
+	});
+
+	pgn::StreamParser parser(in);
+	parser.readGames(collector);
+	collector.flush();
+
+	analysisCache.close();
+	return 0;
+}
@@ -0,0 +1,141 @@
+#include "bot.hpp"
+#include "nnue.hpp"
+#include "searchboard.hpp"
+#include "threadpool.hpp"
+#include <atomic>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <memory>
+#include <new>
+#include <string>
+#include <vector>
+
+// Counts every heap allocation made by the process, so a bench run shows
+// whether the search allocates per node.
+static std::atomic<uint64_t> allocations{0};
+
+void* operator new(size_t size) {
+	allocations.fetch_add(1, std::memory_order_relaxed);
+	if (void* p = std::malloc(size ? size : 1)) {
+		return p;
+	}
+	throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept {
+	std::free(p);
+}
+
+void operator delete(void* p, size_t) noexcept {
+	std::free(p);
+}
+
+const char* BENCH_POSITIONS[] = {
+	"rnbqkbnr/pppppppp/8/8/8/8/PPPPPPPP/RNBQKBNR w KQkq - 0 1",
+	"r1bqkbnr/pppp1ppp/2n5/4p3/4P3/5N2/PPPP1PPP/RNBQKB1R w KQkq - 2 3",
+	"r3k2r/p1ppqpb1/bn2pnp1/3PN3/1p2P3/2N2Q1p/PPPBBPPP/R3K2R w KQkq - 0 1",
+	"r1bq1rk1/pp2ppbp/2np1np1/8/3NP3/2N1BP2/PPPQ2PP/R3KB1R w KQ - 3 9",
+	"r2q1rk1/pp1bbppp/2n1pn2/3p4/2PP4/2N1PN2/PP1QBPPP/R3K2R w KQ - 5 10",
+	"2r3k1/pp3ppp/2n1b3/3p4/3P4/2P1BN2/P4PPP/R5K1 b - - 0 20",
+	"8/2p5/3p4/KP5r/1R3p1k/8/4P1P1/8 w - - 0 1",
+	"6k1/5ppp/8/8/8/8/5PPP/3R2K1 w - - 0 1",
+};
+
+const int EVAL_BENCH_ROUNDS = 20000;
+
+// Makes every legal move from each bench position, evaluates and unmakes it,
+// so the incremental update is part of what gets measured. Returns evals/s.
+double benchEvaluation() {
+	uint64_t evaluations = 0;
+	int64_t checksum = 0;
+	auto td = std::make_unique<ThreadData>();
+	auto start = std::chrono::steady_clock::now();
+
+	for (const char* fen : BENCH_POSITIONS) {
+		SearchBoard board{Board(fen)};
+		Movelist moves;
+		movegen::legalmoves(moves, board);
+		for (int round = 0; round < EVAL_BENCH_ROUNDS; round++) {
+			for (const Move& move : moves) {
+				board.makeMove(move);
+				checksum += evaluate(board, *td);
+				board.unmakeMove(move);
+			}
+		}
+		evaluations += uint64_t(moves.size()) * EVAL_BENCH_ROUNDS;
+	}
+
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	double seconds = std::chrono::duration<double>(elapsed).count();
+	// Printing the checksum keeps the loop from being optimized away
+	std::cout << "    " << evaluations << " evaluations, checksum " << checksum << std::endl;
+	return evaluations / seconds;
+}
+
+// Usage: chessreview-bench [depth] [threads] [--no-null-move] [--no-lmr] [--no-futility] [--nnue file]
+int main(int argc, char** argv) {
+	SearchOptions options;
+	std::string nnueFile;
+	std::vector<std::string> positional;
+	for (int i = 1; i < argc; i++) {
+		std::string arg = argv[i];
+		if (arg == "--no-null-move") {
+			options.nullMove = false;
+		} else if (arg == "--no-lmr") {
+			options.lateMoveReductions = false;
+		} else if (arg == "--no-futility") {
+			options.futility = false;
+		} else if (arg == "--nnue" && i + 1 < argc) {
+			nnueFile = argv[++i];
+		} else {
+			positional.push_back(arg);
+		}
+	}
+
+	int depth = positional.size() > 0 ? std::stoi(positional[0]) : 6;
+	int threads = positional.size() > 1 ? std::stoi(positional[1]) : 1;
+	searchPool.setThreadCount(threads);
+
+	// With a network, compare its evaluation speed against the tables and
+	// then run the search bench on it
+	if (!nnueFile.empty()) {
+		std::cout << "piece-square evaluation" << std::endl;
+		double tableSpeed = benchEvaluation();
+		if (!nnueNetwork.load(nnueFile)) {
+			std::cerr << "Failed to load network " << nnueFile << std::endl;
+			return 1;
+		}
+		std::cout << "nnue evaluation (" << nnueNetwork.simdName() << ")" << std::endl;
+		double nnueSpeed = benchEvaluation();
+		std::cout << "piece-square evals/s " << uint64_t(tableSpeed) << "\n"
+			<< "nnue evals/s " << uint64_t(nnueSpeed) << " (" << nnueSpeed / tableSpeed << "x)" << std::endl;
+	}
+
+	SearchLimits limits;
+	limits.maxDepth = depth;
+
+	uint64_t totalNodes = 0;
+	uint64_t totalAllocations = 0;
+	auto start = std::chrono::steady_clock::now();
+
+	for (const char* fen : BENCH_POSITIONS) {
+		Board board(fen);
+		uint64_t before = allocations;
+		SearchResult result = findBestMove(board, limits, options);
+		uint64_t used = allocations - before;
+
+		totalNodes += result.nodes;
+		totalAllocations += used;
+		std::cout << fen << "\n    bestmove " << uci::moveToUci(result.bestMove) << " score " << result.score
+			<< " depth " << result.depth << " nodes " << result.nodes << " allocations " << used << std::endl;
+	}
+
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	int64_t ms = std::max<int64_t>(1, std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count());
+	std::cout << "nodes " << totalNodes << "\n"
+		<< "time " << ms << " ms\n"
+		<< "nps " << totalNodes * 1000 / ms << "\n"
+		<< "allocations " << totalAllocations << " ("
+		<< double(totalAllocations) / std::max<uint64_t>(1, totalNodes) << " per node)" << std::endl;
+}
@@ -0,0 +1,27 @@
+#include "openingbook.hpp"
+#include <iostream>
+#include <string>
+
+// Converts a text opening book, one FEN per line, into the sorted key file
+// that OpeningBook maps. Any book OpeningBook loads can be the input; a
+// Polyglot book keeps its positions but loses its moves.
+int main(int argc, char** argv) {
+	std::string input = argc > 1 ? argv[1] : "opening_book.txt";
+	std::string output = argc > 2 ? argv[2] : "opening_book.bin";
+	if (argc > 3) {
+		std::cerr << "Usage: chessreview-bookgen [book.txt] [book.bin]" << std::endl;
+		return 1;
+	}
+
+	OpeningBook book;
+	if (!book.load(input)) {
+		std::cerr << "Failed to load " << input << std::endl;
+		return 1;
+	}
+	if (!book.save(output)) {
+		std::cerr << "Failed to write " << output << std::endl;
+		return 1;
+	}
+	std::cerr << "Wrote " << book.size() << " positions to " << output << std::endl;
+	return 0;
+}
@@ -0,0 +1,412 @@
+#include "tablebase.hpp"
+#include <algorithm>
+#include <chrono>
+#include <cstring>
+#include <fstream>
+#include <iostream>
+#include <set>
+#include <string>
+#include <vector>
+
+// Retrograde generator for the tables read by Tablebases.
+//
+// Every position is first classified from its legal moves: mates, stalemates
+// and moves that leave the table (captures and promotions) are resolved by
+// probing the smaller tables, which are generated first. The remaining
+// moves are counted. Then, one ply at a time, positions lost at distance d
+// make their predecessors won at d + 1, and positions won at d count down
+// their predecessors, which are lost at d + 1 once every move has been
+// refuted. What's left unresolved at the end is a draw.
+//
+// The index folds symmetric positions together, and a position symmetric to
+// itself can reach the same folded successor with two moves. So moves are
+// counted, and counted down, once per distinct successor index rather than
+// once per move.
+
+// Memory use is two bytes per position: 480 MB for a five piece table
+// without pawns, and up to 1.4 GB with them.
+const int GENERATOR_MAX_PIECES = 5;
+
+enum GeneratorState : uint8_t {
+	UNKNOWN,
+	WON,
+	LOST,
+	DRAWN,
+	INVALID
+};
+
+// Set when a move out of the table draws, so running out of other moves
+// draws instead of losing
+const uint8_t DRAW_EXIT = 0x80;
+const uint8_t STATE_MASK = 0x7F;
+
+// Board that can be set up directly from a decoded index
+class GeneratorBoard : public Board {
+public:
+	void setPosition(const TablebaseLayout& layout, const Square* squares, Color sideToMove) {
+		Bitboard occupied = occ();
+		while (occupied) {
+			Square sq = occupied.pop();
+			removePiece(at(sq), sq);
+		}
+		for (size_t i = 0; i < layout.pieces.size(); i++) {
+			placePiece(layout.pieces[i], squares[i]);
+		}
+		stm_ = sideToMove;
+		ep_sq_ = Square::underlying::NO_SQ;
+		cr_.clear();
+		hfm_ = 0;
+		prev_states_.clear();
+	}
+};
+
+static std::string sideLetters(const std::string& pieces) {
+	std::string sorted = pieces;
+	std::sort(sorted.begin(), sorted.end(), [](char a, char b) {
+		return std::strchr("QRBNP", a) < std::strchr("QRBNP", b);
+	});
+	return "K" + sorted;
+}
+
+static int sideValue(const std::string& pieces) {
+	int value = 0;
+	for (char letter : pieces) {
+		value += letter == 'Q' ? 9 : letter == 'R' ? 5 : letter == 'B' || letter == 'N' ? 3 : letter == 'P' ? 1 : 0;
+	}
+	return value;
+}
+
+// Name with the stronger side first, or an empty string for a bare king
+// against a bare king, which needs no table
+static std::string canonicalName(const std::string& first, const std::string& second) {
+	if (first.empty() && second.empty()) {
+		return "";
+	}
+	std::string a = sideLetters(first);
+	std::string b = sideLetters(second);
+	if (sideValue(first) < sideValue(second) || (sideValue(first) == sideValue(second) && a < b)) {
+		std::swap(a, b);
+	}
+	return a + "v" + b;
+}
+
+// Tables reachable by one capture or promotion
+static std::set<std::string> dependencies(const std::string& name) {
+	size_t separator = name.find('v');
+	std::string sides[2] = {name.substr(1, separator - 1), name.substr(separator + 2)};
+	std::set<std::string> result;
+
+	for (int side = 0; side < 2; side++) {
+		const std::string& own = sides[side];
+		const std::string& other = sides[side ^ 1];
+
+		// Captures by the other side
+		for (size_t i = 0; i < own.size(); i++) {
+			std::string remaining = own.substr(0, i) + own.substr(i + 1);
+			result.insert(side == 0 ? canonicalName(remaining, other) : canonicalName(other, remaining));
+		}
+
+		// Promotions, with or without a capture
+		size_t pawn = own.find('P');
+		if (pawn == std::string::npos) {
+			continue;
+		}
+		for (char promoted : std::string("QRBN")) {
+			std::string next = own;
+			next[pawn] = promoted;
+			result.insert(side == 0 ? canonicalName(next, other) : canonicalName(other, next));
+			for (size_t i = 0; i < other.size(); i++) {
+				std::string captured = other.substr(0, i) + other.substr(i + 1);
+				result.insert(side == 0 ? canonicalName(next, captured) : canonicalName(captured, next));
+			}
+		}
+	}
+	result.erase("");
+	return result;
+}
+
+static bool validPosition(const TablebaseLayout& layout, const Square* squares) {
+	uint64_t occupied = 0;
+	for (size_t i = 0; i < layout.pieces.size(); i++) {
+		uint64_t bit = 1ULL << squares[i].index();
+		if (occupied & bit) {
+			return false;
+		}
+		occupied |= bit;
+		if (layout.pieces[i].type() == PieceType::PAWN
+			&& (squares[i].rank() == Rank::RANK_1 || squares[i].rank() == Rank::RANK_8)) {
+			return false;
+		}
+		// Only the sorted order of identical pieces is used
+		if (i > 1 && layout.pieces[i] == layout.pieces[i - 1] && squares[i].index() < squares[i - 1].index()) {
+			return false;
+		}
+	}
+	return true;
+}
+
+// Squares the piece on `to` could have come from with a non-capturing,
+// non-promoting move
+static Bitboard retroOrigins(Piece piece, Square to, Bitboard occupied) {
+	switch (static_cast<int>(piece.type())) {
+		case static_cast<int>(PieceType::KNIGHT):
+			return attacks::knight(to) & ~occupied;
+		case static_cast<int>(PieceType::BISHOP):
+			return attacks::bishop(to, occupied) & ~occupied;
+		case static_cast<int>(PieceType::ROOK):
+			return attacks::rook(to, occupied) & ~occupied;
+		case static_cast<int>(PieceType::QUEEN):
+			return attacks::queen(to, occupied) & ~occupied;
+		case static_cast<int>(PieceType::KING):
+			return attacks::king(to) & ~occupied;
+		default:
+			break;
+	}
+
+	bool white = piece.color() == Color::WHITE;
+	int rank = white ? int(to.rank()) : 7 - int(to.rank());
+	int back = white ? -8 : 8;
+	Bitboard origins;
+	// A pawn on its second rank can't have pushed there
+	if (rank >= 2) {
+		Square single(to.index() + back);
+		if (!(occupied & Bitboard::fromSquare(single))) {
+			origins |= Bitboard::fromSquare(single);
+			Square twice(to.index() + 2 * back);
+			if (rank == 3 && !(occupied & Bitboard::fromSquare(twice))) {
+				origins |= Bitboard::fromSquare(twice);
+			}
+		}
+	}
+	return origins;
+}
+
+static bool writeTable(const std::string& path, TablebaseKind kind, const TablebaseLayout& layout, const std::vector<uint8_t>& payload) {
+	TablebaseHeader header = {};
+	std::memcpy(header.magic, "CRTB", 4);
+	header.kind = kind;
+	std::strncpy(header.name, layout.name.c_str(), sizeof(header.name) - 1);
+	header.entries = layout.entries;
+
+	std::ofstream os(path, std::ios::binary);
+	os.write(reinterpret_cast<const char*>(&header), sizeof(header));
+	os.write(reinterpret_cast<const char*>(payload.data()), payload.size());
+	return bool(os);
+}
+
+static bool generate(const TablebaseLayout& layout, const std::string& directory) {
+	auto start = std::chrono::steady_clock::now();
+	const uint64_t entries = layout.entries;
+	const size_t count = layout.pieces.size();
+
+	std::vector<uint8_t> state(entries, UNKNOWN);
+	// Successors still to be refuted while a position is unknown, then its
+	// distance once it's won or lost
+	std::vector<uint8_t> distance(entries, 0);
+
+	GeneratorBoard board;
+	Square squares[TABLEBASE_MAX_PIECES];
+	Color sideToMove;
+
+	// Classify every position from its own moves
+	for (uint64_t index = 0; index < entries; index++) {
+		tablebaseDecode(layout, index, squares, sideToMove);
+		Square folded[TABLEBASE_MAX_PIECES];
+		std::copy(squares, squares + count, folded);
+		if (!validPosition(layout, squares) || tablebaseIndex(layout, folded, sideToMove) != index) {
+			state[index] = INVALID;
+			continue;
+		}
+		board.setPosition(layout, squares, sideToMove);
+		if (board.isAttacked(board.kingSq(~sideToMove), sideToMove)) {
+			state[index] = INVALID;
+			continue;
+		}
+
+		Movelist moves;
+		movegen::legalmoves(moves, board);
+		if (moves.empty()) {
+			state[index] = board.inCheck() ? LOST : DRAWN;
+			continue;
+		}
+
+		bool won = false;
+		bool drawExit = false;
+		uint64_t successors[256];
+		int inside = 0;
+		for (const Move& move : moves) {
+			if (!board.isCapture(move) && move.typeOf() != Move::PROMOTION) {
+				Square after[TABLEBASE_MAX_PIECES];
+				std::copy(squares, squares + count, after);
+				*std::find(after, after + count, move.from()) = move.to();
+				successors[inside++] = tablebaseIndex(layout, after, ~sideToMove);
+				continue;
+			}
+			board.makeMove(move);
+			TablebaseResult result;
+			bool found = tablebases.probe(board, result);
+			board.unmakeMove(move);
+			if (!found) {
+				std::cerr << "Missing table for " << board.getFen() << " " << uci::moveToUci(move) << std::endl;
+				return false;
+			}
+			won |= result.wdl == TB_LOSS;
+			drawExit |= result.wdl == TB_DRAW;
+		}
+
+		std::sort(successors, successors + inside);
+		inside = int(std::unique(successors, successors + inside) - successors);
+
+		if (won) {
+			state[index] = WON;
+			distance[index] = 1;
+		}
+		else if (inside == 0) {
+			state[index] = drawExit ? DRAWN : LOST;
+			distance[index] = 1;
+		}
+		else {
+			state[index] = UNKNOWN | (drawExit ? DRAW_EXIT : 0);
+			distance[index] = uint8_t(inside);
+		}
+	}
+
+	// Retrograde passes, one ply at a time
+	for (int ply = 0; ply < 255; ply++) {
+		bool any = false;
+		for (uint64_t index = 0; index < entries; index++) {
+			uint8_t current = state[index];
+			if ((current != WON && current != LOST) || distance[index] != ply) {
+				continue;
+			}
+			any = true;
+
+			tablebaseDecode(layout, index, squares, sideToMove);
+			Color mover = ~sideToMove;
+			Bitboard occupied;
+			for (size_t i = 0; i < count; i++) {
+				occupied |= Bitboard::fromSquare(squares[i]);
+			}
+
+			uint64_t predecessors[256];
+			int found = 0;
+			for (size_t i = 0; i < count; i++) {
+				if (layout.pieces[i].color() != mover) {
+					continue;
+				}
+				Bitboard origins = retroOrigins(layout.pieces[i], squares[i], occupied);
+				while (origins) {
+					Square before[TABLEBASE_MAX_PIECES];
+					std::copy(squares, squares + count, before);
+					before[i] = Square(origins.pop());
+					uint64_t previous = tablebaseIndex(layout, before, mover);
+					if (previous != TABLEBASE_NO_INDEX) {
+						predecessors[found++] = previous;
+					}
+				}
+			}
+			std::sort(predecessors, predecessors + found);
+			found = int(std::unique(predecessors, predecessors + found) - predecessors);
+
+			for (int i = 0; i < found; i++) {
+				uint64_t previous = predecessors[i];
+				uint8_t& previousState = state[previous];
+				if ((previousState & STATE_MASK) != UNKNOWN) {
+					continue;
+				}
+				if (current == LOST) {
+					previousState = WON;
+					distance[previous] = uint8_t(ply + 1);
+				}
+				else if (--distance[previous] == 0) {
+					previousState = (previousState & DRAW_EXIT) ? DRAWN : LOST;
+					distance[previous] = uint8_t(ply + 1);
+				}
+			}
+		}
+		if (!any && ply >= 1) {
+			break;
+		}
+	}
+
+	std::vector<uint8_t> wdl((entries + 3) / 4, 0);
+	uint64_t wins = 0, draws = 0, losses = 0;
+	int longest = 0;
+	for (uint64_t index = 0; index < entries; index++) {
+		uint8_t current = state[index] & STATE_MASK;
+		TablebaseWdl value = current == WON ? TB_WIN : current == LOST ? TB_LOSS : current == INVALID ? TB_UNUSED : TB_DRAW;
+		wdl[index / 4] |= uint8_t(value << (index % 4 * 2));
+		if (value != TB_WIN && value != TB_LOSS) {
+			distance[index] = 0;
+		}
+		wins += value == TB_WIN;
+		losses += value == TB_LOSS;
+		draws += value == TB_DRAW;
+		longest = std::max<int>(longest, distance[index]);
+	}
+
+	std::string base = directory + "/" + layout.name;
+	if (!writeTable(base + ".wdl", TABLEBASE_WDL, layout, wdl) || !writeTable(base + ".dtc", TABLEBASE_DTC, layout, distance)) {
+		std::cerr << "Failed to write " << base << std::endl;
+		return false;
+	}
+
+	auto elapsed = std::chrono::steady_clock::now() - start;
+	std::cout << layout.name << ": " << wins << " won, " << draws << " drawn, " << losses << " lost, longest "
+		<< longest << " plies, " << std::chrono::duration_cast<std::chrono::milliseconds>(elapsed).count()
+		<< " ms" << std::endl;
+	return true;
+}
+
+// Generates a table after everything it depends on
+static bool generateWithDependencies(const std::string& name, const std::string& directory, std::set<std::string>& done) {
+	if (done.count(name)) {
+		return true;
+	}
+	for (const std::string& dependency : dependencies(name)) {
+		if (!generateWithDependencies(dependency, directory, done)) {
+			return false;
+		}
+	}
+
+	TablebaseLayout layout;
+	parseTablebaseName(name, layout);
+	std::ifstream existing(directory + "/" + layout.name + ".wdl");
+	if (!existing.good()) {
+		if (!generate(layout, directory)) {
+			return false;
+		}
+		tablebases.load(directory);
+	}
+	done.insert(name);
+	return true;
+}
+
+// Usage: chessreview-tbgen <directory> <table>...   e.g. chessreview-tbgen tablebases KQvK KRvK KPvK
+int main(int argc, char** argv) {
+	if (argc < 3) {
+		std::cerr << "Usage: chessreview-tbgen <directory> <table>..." << std::endl;
+		return 1;
+	}
+	std::string directory = argv[1];
+	tablebases.load(directory);
+
+	std::set<std::string> done;
+	for (int i = 2; i < argc; i++) {
+		TablebaseLayout layout;
+		if (!parseTablebaseName(argv[i], layout)) {
+			std::cerr << "Invalid table name " << argv[i] << std::endl;
+			return 1;
+		}
+		if (int(layout.pieces.size()) > GENERATOR_MAX_PIECES) {
+			std::cerr << layout.name << " has more than " << GENERATOR_MAX_PIECES << " pieces" << std::endl;
+			return 1;
+		}
+		size_t separator = layout.name.find('v');
+		std::string name = canonicalName(layout.name.substr(1, separator - 1), layout.name.substr(separator + 2));
+		if (!generateWithDependencies(name, directory, done)) {
+			return 1;
+		}
+	}
+	return 0;
+}